@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include "../typedefs.h"
+#include "../obj.h"
+
+/**
+ * cluster build throughput and culling rate. loads each file the way main
+ * does, checks every cluster against the size limits and every culled one
+ * against its triangles, then reports what main's camera culls at its
+ * default yaw of 180 and turned around to yaw 0 (tree.obj is behind the
+ * default view).
+ *
+ * usage: bench_clusters [file...]
+ * with no files, res/models/tree.obj is used
+ */
+
+/**
+ * main's camera after it settles at (0, 0, 4), square window
+ */
+static void
+camera_at(float yaw, m4 *vp, v3 *eye) {
+  *eye = (v3){0, 0, 4};
+  v3 front = {sinf(rad(yaw)), 0, cosf(rad(yaw))};
+  v3 right = v3_cross(v3_uy, front);
+  v3 up = v3_mul(v3_cross(right, front), -1);
+  *vp = m4_mul(m4_look(*eye, front, up), m4_persp(rad(45.f), 1, 0.001, 100.f));
+}
+
+static v3
+decode(struct obj_mesh const *m, uint32_t i) {
+  if (m->vt_size != sizeof(struct vtq)) return ((struct vt const *)m->data)[i].p;
+
+  struct vtq const *q = m->data;
+  v3 ext = v3_div(v3_sub(m->hi, m->lo), 65535);
+  return v3_add(m->lo, v3_mul_v((v3){q[i].p[0], q[i].p[1], q[i].p[2]}, ext));
+}
+
+/**
+ * counts what the frustum and the cones cull from yaw, and checks that no
+ * culled cluster has a triangle that could have been visible
+ */
+static int
+cull(struct obj_mesh const *m, struct geom_clusters const *c, float yaw) {
+  m4 vp;
+  v3 eye;
+  v4 planes[6];
+  camera_at(yaw, &vp, &eye);
+  geom_frustum(vp, planes);
+
+  int bad = 0, n_frustum = 0, n_cone = 0, t_culled = 0;
+  for (int i = 0; i < c->n; i++) {
+    bool out = geom_cl_outside(c, i, planes);
+    bool back = !out && geom_cl_backfacing(c, i, eye);
+    n_frustum += out;
+    n_cone += back;
+    if (!out && !back) continue;
+
+    t_culled += c->tri[i + 1] - c->tri[i];
+    for (int j = c->tri[i] * 3; j < c->tri[i + 1] * 3; j += 3) {
+      v3 a = decode(m, geom_ind(m->inds, m->ind_size, j));
+      v3 b = decode(m, geom_ind(m->inds, m->ind_size, j + 1));
+      v3 d = decode(m, geom_ind(m->inds, m->ind_size, j + 2));
+
+      bool wrong = false;
+      if (back) {
+        wrong = v3_dot(v3_cross(v3_sub(b, a), v3_sub(d, a)), v3_sub(a, eye)) < 0;
+      } else {
+        /* all three corners have to be outside the same clip plane */
+        v4 clip[3];
+        for (int k = 0; k < 3; k++) {
+          v3 p = k == 0 ? a : k == 1 ? b : d;
+          clip[k] = v4_mul_m((v4){p.x, p.y, p.z, 1}, vp);
+        }
+
+        wrong = true;
+        for (int pl = 0; pl < 6 && wrong; pl++) {
+          bool all = true;
+          for (int k = 0; k < 3; k++) {
+            float e = pl & 1 ? -clip[k].v[pl / 2] : clip[k].v[pl / 2];
+            all &= clip[k].w + e < 0;
+          }
+
+          wrong = !all;
+        }
+      }
+
+      if (wrong) {
+        printf("  cluster %d culled by %s but triangle %d is visible\n", i, back ? "cone" : "frustum", j / 3);
+        bad++;
+        break;
+      }
+    }
+  }
+
+  int n_t = m->lod_off[1] / 3;
+  printf("  yaw %3.0f culls %5.1f%% of clusters (frustum %5.1f%%, cone %5.1f%%), %5.1f%% of triangles\n",
+         yaw, 100. * (n_frustum + n_cone) / max(c->n, 1), 100. * n_frustum / max(c->n, 1),
+         100. * n_cone / max(c->n, 1), 100. * t_culled / max(n_t, 1));
+  return bad;
+}
+
+static int
+bench_file(char const *path) {
+  struct obj_mesh m;
+  obj_load(&m, path, obj_vt | obj_overdraw | obj_quant);
+
+  /* each rep frees the last one's clusters, so the final rep's are what get checked */
+  struct geom_clusters c = {0};
+  double best = INFINITY;
+  int reps = 0;
+  for (double t_end = sys_time() + 0.5; reps < 3 || sys_time() < t_end; reps++) {
+    geom_clusters_free(&c);
+    double t0 = sys_time();
+    obj_clusters(&c, &m);
+    best = min(best, sys_time() - t0);
+  }
+
+  int bad = 0, max_v = 0, max_t = 0;
+  int *stamp = calloc(max(m.n_data, 1), sizeof(int));
+  for (int i = 0; i < c.n; i++) {
+    int nv = 0;
+    for (int j = c.tri[i] * 3; j < c.tri[i + 1] * 3; j++) {
+      uint32_t v = geom_ind(m.inds, m.ind_size, j);
+      if (stamp[v] != i + 1) stamp[v] = i + 1, nv++;
+    }
+
+    max_v = max(max_v, nv);
+    max_t = max(max_t, c.tri[i + 1] - c.tri[i]);
+  }
+
+  free(stamp);
+  if (max_v > geom_cl_verts || max_t > geom_cl_tris) {
+    printf("  cluster over the limits: %d vertices, %d triangles\n", max_v, max_t);
+    bad++;
+  }
+
+  int n_t = m.lod_off[1] / 3;
+  printf("  %d clusters, %.1f triangles each, largest %d vertices / %d triangles\n",
+         c.n, c.n ? (float)n_t / c.n : 0, max_v, max_t);
+  printf("  build %9.2f ms %9.1f Mtri/s (best of %d)\n", best * 1e3, n_t / best * 1e-6, reps);
+
+  bad += cull(&m, &c, 180);
+  bad += cull(&m, &c, 0);
+
+  geom_clusters_free(&c);
+  obj_mesh_free(&m);
+  return bad;
+}
+
+int
+main(int argc, char **argv) {
+  char const *def[] = {"./res/models/tree.obj"};
+  char const **files = argc > 1 ? (char const **)argv + 1 : def;
+  int n_files = argc > 1 ? argc - 1 : 1;
+
+  int bad = 0;
+  for (int i = 0; i < n_files; i++) {
+    printf("%s\n", files[i]);
+    bad += bench_file(files[i]);
+  }
+
+  return bad != 0;
+}
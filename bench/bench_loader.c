@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include "../typedefs.h"
+#include "../obj.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+/**
+ * loader throughput: runs every obj path over each file, checks they all
+ * produce the same struct vt stream and prints MB/s, triangles/s, peak
+ * resident memory and how many allocations each path made.
+ *
+ * usage: bench_loader [--faces n] [--style vt|vn] [--digits lo:hi] [--reps n] [file...]
+ * with no files, res/models/tree.obj and a synthetic obj are used. the
+ * synthetic file has n faces (default 10M), v/vt/vn or v//vn indices, and
+ * each coordinate printed with lo to hi decimals picked at random (default
+ * 6:6), which spreads out line lengths. it is generated once per set of
+ * options and then reused. a bare number before the files is taken as
+ * --faces
+ *
+ * peak memory is the process's high-water mark, reset before each path
+ * on Linux. allocations are counted where the linker can wrap malloc
+ */
+
+static uint64_t g_rng = 0x9e3779b97f4a7c15;
+
+static uint32_t
+rng(void) {
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 7;
+  g_rng ^= g_rng << 17;
+  return (uint32_t)(g_rng >> 32);
+}
+
+static float
+rngf(void) {
+  return (float)rng() / 4294967296.f * 2.f - 1.f;
+}
+
+/*-- allocation counts --*/
+
+#ifdef BENCH_WRAP_MALLOC
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+static atomic_llong g_allocs, g_alloc_bytes;
+
+void *
+__wrap_malloc(size_t n) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&g_alloc_bytes, n, memory_order_relaxed);
+  return __real_malloc(n);
+}
+
+void *
+__wrap_calloc(size_t n, size_t size) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&g_alloc_bytes, n * size, memory_order_relaxed);
+  return __real_calloc(n, size);
+}
+
+void *
+__wrap_realloc(void *p, size_t n) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&g_alloc_bytes, n, memory_order_relaxed);
+  return __real_realloc(p, n);
+}
+#else
+static long long g_allocs = -1, g_alloc_bytes = -1;
+#endif
+
+/*-- memory --*/
+
+/**
+ * starts a new high-water mark for peak_rss where the OS allows it
+ */
+static void
+peak_reset(void) {
+#ifdef __linux__
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) return;
+  if (write(fd, "5", 1) != 1) {}
+  close(fd);
+#endif
+}
+
+/**
+ * the process's peak resident set in MB, or -1 if unknown
+ */
+static double
+peak_rss(void) {
+#ifdef __linux__
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (!fp) return -1;
+
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+  }
+
+  fclose(fp);
+  return kb < 0 ? -1 : kb / 1024.;
+#elif defined(_WIN32)
+  return -1;
+#else
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+  return ru.ru_maxrss / (1024. * 1024.);
+#else
+  return ru.ru_maxrss / 1024.;
+#endif
+#endif
+}
+
+/*-- generator --*/
+
+struct gen {
+  long n_faces;
+  bool t;
+  int digits[2];
+};
+
+/**
+ * a coordinate with lo to hi decimals, so line lengths vary the way they
+ * do between exporters
+ */
+static void
+gen_float(FILE *fp, struct gen const *g, float f) {
+  int d = g->digits[0] + (g->digits[1] > g->digits[0] ? rng() % (g->digits[1] - g->digits[0] + 1) : 0);
+  fprintf(fp, " %.*f", d, f);
+}
+
+/**
+ * a ribbon of triangles that reference nearby vertices, laid out like an
+ * exporter would: all v, then vt, then vn, then f with v/vt/vn indices,
+ * or v, vn and v//vn faces without t
+ */
+static void
+gen_obj(char const *path, struct gen const *g) {
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    err("failed to create %s", path);
+  }
+
+  static char buf[1 << 20];
+  setvbuf(fp, buf, _IOFBF, sizeof(buf));
+
+  long nv = g->n_faces / 2 + 2;
+  for (long i = 0; i < nv; i++) {
+    fputc('v', fp);
+    for (int k = 0; k < 3; k++) gen_float(fp, g, rngf() * 10);
+    fputc('\n', fp);
+  }
+
+  if (g->t) {
+    for (long i = 0; i < nv; i++) {
+      fputs("vt", fp);
+      for (int k = 0; k < 2; k++) gen_float(fp, g, rngf());
+      fputc('\n', fp);
+    }
+  }
+
+  for (long i = 0; i < nv; i++) {
+    fputs("vn", fp);
+    for (int k = 0; k < 3; k++) gen_float(fp, g, rngf());
+    fputc('\n', fp);
+  }
+
+  for (long i = 0; i < g->n_faces; i++) {
+    long a = i / 2 + 1, b = a + 1, c = a + 2;
+    if (g->t) fprintf(fp, "f %ld/%ld/%ld %ld/%ld/%ld %ld/%ld/%ld\n", a, a, a, b, b, b, c, c, c);
+    else fprintf(fp, "f %ld//%ld %ld//%ld %ld//%ld\n", a, a, b, b, c, c);
+  }
+
+  fclose(fp);
+}
+
+/*-- bench --*/
+
+/**
+ * the longest line in path, newline included
+ */
+static size_t
+file_max_line(char const *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return 0;
+
+  static char buf[1 << 16];
+  size_t best = 0, cur = 0, n;
+  while ((n = fread(buf, 1, sizeof(buf), fp))) {
+    for (char const *p = buf, *end = buf + n; p < end;) {
+      char const *nl = memchr(p, '\n', end - p);
+      if (!nl) {
+        cur += end - p;
+        break;
+      }
+
+      best = max(best, cur + (nl - p) + 1);
+      cur = 0;
+      p = nl + 1;
+    }
+  }
+
+  fclose(fp);
+  return max(best, cur);
+}
+
+static size_t
+file_len(char const *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return 0;
+  fseek(fp, 0, SEEK_END);
+  size_t len = (size_t)ftell(fp);
+  fclose(fp);
+  return len;
+}
+
+/**
+ * checksum of n vertices that start at index off. each vertex's hash is
+ * weighted by its index, so a sum over blocks matches the sum over the
+ * whole array however it was split
+ */
+static uint64_t
+vt_sum(struct vt const *v, int64_t off, int64_t n) {
+  uint64_t sum = 0;
+  for (int64_t i = 0; i < n; i++) {
+    sum += (uint64_t)hash_murmur3(&v[i], sizeof(struct vt)) * (2 * (uint64_t)(off + i) + 1);
+  }
+
+  return sum;
+}
+
+/**
+ * the bounded-memory path main takes for big files: a loader thread fills
+ * blocks, and this one checksums each before handing it back, so only the
+ * pool is ever resident
+ */
+static uint64_t
+parse_stream(char const *path, bool t, int *n_out) {
+  struct obj_stream st;
+  obj_stream_init(&st, path, (t ? obj_vt : 0) | obj_stream, (size_t)256 << 20);
+
+  thrd_t th;
+  if (thrd_create(&th, obj_stream_run, &st) != thrd_success) {
+    err("failed to spawn the stream thread");
+  }
+
+  while (!atomic_load(&st.scanned)) thrd_yield();
+
+  uint64_t sum = 0;
+  while (!obj_stream_done(&st)) {
+    int slot;
+    int64_t off, n;
+    struct vt const *blk = obj_stream_peek(&st, &slot, &off, &n);
+    if (!blk) {
+      thrd_yield();
+      continue;
+    }
+
+    sum += vt_sum(blk, off, n);
+    obj_stream_release(&st, slot);
+  }
+
+  thrd_join(th, NULL);
+  *n_out = (int)st.n_verts;
+  obj_stream_free(&st);
+  return sum;
+}
+
+enum { path_stdio, path_mmap, path_stream };
+
+/**
+ * t is whether faces are v/vt/vn. stdio only reads lines up to 128 bytes,
+ * so it sits out files with longer ones.
+ *
+ * paths are checked against each other by checksum, and each path's output
+ * is freed before the next runs, so a peak only holds that path's memory.
+ * the time, peak and allocations printed all come from the fastest rep
+ */
+static void
+bench_file(char const *path, bool t, int reps) {
+  double mb = (double)file_len(path) / (1 << 20);
+  size_t max_line = file_max_line(path);
+  printf("%s (%.1f MB)\n", path, mb);
+  printf("  %-16s %9s %9s %9s %9s %10s %10s\n", "path", "ms", "MB/s", "Mtri/s", "peak MB", "allocs", "alloc MB");
+
+  int n_ref = -1;
+  uint64_t sum_ref = 0;
+  char const *ref_name = NULL;
+
+  struct {
+    char const *name;
+    int kind, n_threads;
+  } paths[] = {
+    {"stdio", path_stdio, 0},
+    {"mmap 1 thread", path_mmap, 1},
+    {"mmap all cores", path_mmap, 0},
+    {"stream", path_stream, 0},
+  };
+
+  for (int i = 0; i < (int)(sizeof(paths) / sizeof(*paths)); i++) {
+    if (paths[i].kind == path_stdio && max_line >= 128) {
+      printf("  %-16s skipped, lines are up to %zu bytes\n", paths[i].name, max_line);
+      continue;
+    }
+
+    double best = 1e30, peak = 0;
+    long long allocs = 0, bytes = 0;
+    int n = 0;
+    for (int r = 0; r < reps; r++) {
+      peak_reset();
+      long long a0 = g_allocs, b0 = g_alloc_bytes;
+      double t0 = sys_time();
+
+      /* streams checksum as they go, like uploads would; the others after the clock stops */
+      struct vt *v = NULL;
+      uint64_t sum = paths[i].kind == path_stream ? parse_stream(path, t, &n) : 0;
+      if (paths[i].kind == path_stdio) v = obj_parse_stdio(path, t, &n);
+      if (paths[i].kind == path_mmap) v = obj_parse(path, t, paths[i].n_threads, &n);
+
+      double dt = sys_time() - t0;
+      long long a1 = g_allocs, b1 = g_alloc_bytes;
+      if (dt < best) {
+        best = dt;
+        peak = peak_rss();
+        allocs = g_allocs < 0 ? -1 : a1 - a0;
+        bytes = b1 - b0;
+      }
+
+      if (v) {
+        sum = vt_sum(v, 0, n);
+        free(v);
+      }
+
+      if (n_ref < 0) {
+        n_ref = n, sum_ref = sum, ref_name = paths[i].name;
+      } else if (n != n_ref || sum != sum_ref) {
+        err("%s: path '%s' disagrees with '%s' (%d vs %d vertices)", path, paths[i].name, ref_name, n, n_ref);
+      }
+    }
+
+    printf("  %-16s %9.1f %9.1f %9.2f %9.1f", paths[i].name, best * 1e3, mb / best, n / 3 / best * 1e-6, peak);
+    if (allocs >= 0) printf(" %10lld %10.1f\n", allocs, bytes / (double)(1 << 20));
+    else printf(" %10s %10s\n", "-", "-");
+  }
+}
+
+int
+main(int argc, char **argv) {
+  struct gen g = {.n_faces = 10000000, .t = true, .digits = {6, 6}};
+  int reps = 0, n_files = 0;
+  char const **files = malloc(sizeof(char *) * max(argc, 1));
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--faces") == 0 && i + 1 < argc) {
+      g.n_faces = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--style") == 0 && i + 1 < argc) {
+      g.t = strcmp(argv[++i], "vn") != 0;
+    } else if (strcmp(argv[i], "--digits") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%d:%d", &g.digits[0], &g.digits[1]) == 1) g.digits[1] = g.digits[0];
+    } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      reps = atoi(argv[++i]);
+    } else if (i == 1 && atol(argv[i]) > 0) {
+      g.n_faces = atol(argv[i]);
+    } else {
+      files[n_files++] = argv[i];
+    }
+  }
+
+  g.digits[0] = clamp(g.digits[0], 0, 30);
+  g.digits[1] = clamp(g.digits[1], g.digits[0], 30);
+
+  if (n_files) {
+    for (int i = 0; i < n_files; i++) bench_file(files[i], g.t, reps ? reps : 3);
+    free(files);
+    return 0;
+  }
+
+  char synth[96];
+  snprintf(synth, sizeof(synth), "synth_%ld_%s_%d-%d.obj", g.n_faces, g.t ? "vt" : "vn", g.digits[0], g.digits[1]);
+  if (!file_len(synth)) {
+    printf("generating %s\n", synth);
+    gen_obj(synth, &g);
+  }
+
+  bench_file("./res/models/tree.obj", true, reps ? reps : 5);
+  bench_file(synth, g.t, reps ? reps : 1);
+  free(files);
+  return 0;
+}
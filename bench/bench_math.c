@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include "../typedefs.h"
+
+/**
+ * the math layer in typedefs.h over large random batches: ns per call and,
+ * for the kernels that stream arrays, GB/s of what they read and write.
+ * each kernel's best of several passes is checked against the baseline
+ * file, and any that got slower than it by more than the threshold fails
+ * the run.
+ *
+ * usage: bench_math [--baseline file] [--threshold percent] [--write-baseline]
+ * absolute timings only compare on the machine that took them, so the
+ * baseline is per machine and never committed: --write-baseline records
+ * this run's numbers to ./bench_math.baseline (or --baseline), and later
+ * runs on the same machine compare against it. with no baseline a run
+ * only reports.
+ *
+ * to ride out clock and load changes between runs:
+ *  - every time is relative to a fixed reference loop timed in the same run
+ *  - every time is the best over n_rounds short rounds through all the
+ *    kernels, so a slow stretch hits one round rather than one kernel
+ *  - a kernel over the threshold is timed again a few times before it counts
+ * the default threshold of 25% is what that still needs on a busy
+ * single-core VM; a quiet machine can hold a tighter --threshold
+ */
+
+enum { n_batch = 1 << 16, n_stream = 1 << 20, n_kernels = 8, n_rounds = 8 };
+
+struct kernel {
+  char const *name;
+  double ns, gbs, base;
+};
+
+static uint64_t g_rng = 0x9e3779b97f4a7c15;
+
+static float
+rngf(void) {
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 7;
+  g_rng ^= g_rng << 17;
+  return (float)(g_rng >> 40) / 16777216.f * 2.f - 1.f;
+}
+
+static v3
+rng_v3(void) {
+  return (v3){rngf(), rngf(), rngf()};
+}
+
+static m4
+rng_m4(void) {
+  m4 m;
+  for (int i = 0; i < 16; i++) m.e[i] = rngf();
+  return m;
+}
+
+/* keeps results alive without the compiler seeing through them */
+static volatile float g_sink;
+
+static m4 *g_a, *g_b, *g_m;
+static v3 *g_p, *g_d, *g_v3;
+static v4 *g_v4, *g_o4;
+static uint8_t *g_bytes;
+
+static void
+run_m4_mul(void) {
+  for (int i = 0; i < n_batch; i++) g_m[i] = m4_mul(g_a[i], g_b[i]);
+  g_sink = g_m[n_batch - 1]._33;
+}
+
+static void
+run_m4_look(void) {
+  for (int i = 0; i < n_batch; i++) g_m[i] = m4_look(g_p[i], g_d[i], v3_uy);
+  g_sink = g_m[n_batch - 1]._32;
+}
+
+static void
+run_m4_persp(void) {
+  for (int i = 0; i < n_batch; i++) g_m[i] = m4_persp(1 + g_p[i].x * 0.5f, 1 + g_p[i].y * 0.5f, 0.01f, 100.f);
+  g_sink = g_m[n_batch - 1]._32;
+}
+
+static void
+run_v3_normed(void) {
+  for (int i = 0; i < n_stream; i++) g_v3[i] = v3_normed(g_d[i % n_batch]);
+  g_sink = g_v3[n_stream - 1].x;
+}
+
+static void
+run_v4_mul_m(void) {
+  m4 m = g_a[0];
+  for (int i = 0; i < n_stream; i++) g_o4[i] = v4_mul_m(g_v4[i], m);
+  g_sink = g_o4[n_stream - 1].w;
+}
+
+static void
+run_murmur3_16(void) {
+  uint32_t h = 0;
+  for (int i = 0; i < n_batch; i++) h ^= hash_murmur3(g_bytes + i * 16, 16);
+  g_sink = (float)h;
+}
+
+static void
+run_murmur3_64k(void) {
+  uint32_t h = 0;
+  for (int i = 0; i < 16; i++) h ^= hash_murmur3(g_bytes + i * 65536, 65536);
+  g_sink = (float)h;
+}
+
+static void
+run_murmur3_16m(void) {
+  g_sink = (float)hash_murmur3(g_bytes, (size_t)16 << 20);
+}
+
+/**
+ * a dependent chain of integer multiply-adds: nothing in typedefs.h, so
+ * only the machine's speed moves it
+ */
+static void
+run_ref(void) {
+  uint32_t x = 1;
+  for (int i = 0; i < n_stream; i++) x = x * 1664525u + 1013904223u;
+  g_sink = (float)x;
+}
+
+/**
+ * best of at least 3 passes and secs, per op
+ */
+static double
+best_ns(void (*fn)(void), long n_ops, double secs) {
+  double best = INFINITY;
+  int reps = 0;
+  for (double t_end = sys_time() + secs; reps < 3 || sys_time() < t_end; reps++) {
+    double t0 = sys_time();
+    fn();
+    best = min(best, sys_time() - t0);
+  }
+
+  return best * 1e9 / n_ops;
+}
+
+static bool
+load_baseline(char const *path, struct kernel *ks, double *ref) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) return false;
+
+  char line[256], name[64];
+  double ns;
+  while (fgets(line, sizeof(line), fp)) {
+    if (line[0] == '#' || sscanf(line, "%63s %lf", name, &ns) != 2) continue;
+    if (strcmp(name, "ref") == 0) *ref = ns;
+    for (int i = 0; i < n_kernels; i++) {
+      if (strcmp(ks[i].name, name) == 0) ks[i].base = ns;
+    }
+  }
+
+  fclose(fp);
+  return true;
+}
+
+static void
+store_baseline(char const *path, struct kernel const *ks, double ref) {
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    err("failed to write %s", path);
+  }
+
+  fprintf(fp, "# bench_math ns/op, written by bench_math --write-baseline\n");
+  fprintf(fp, "ref %.4f\n", ref);
+  for (int i = 0; i < n_kernels; i++) fprintf(fp, "%s %.4f\n", ks[i].name, ks[i].ns);
+  fclose(fp);
+}
+
+int
+main(int argc, char **argv) {
+  char const *path = "./bench_math.baseline";
+  double threshold = 25;
+  bool update = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) path = argv[++i];
+    else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+    else if (strcmp(argv[i], "--write-baseline") == 0) update = true;
+  }
+
+  g_a = malloc(sizeof(m4) * n_batch);
+  g_b = malloc(sizeof(m4) * n_batch);
+  g_m = malloc(sizeof(m4) * n_batch);
+  g_p = malloc(sizeof(v3) * n_batch);
+  g_d = malloc(sizeof(v3) * n_batch);
+  g_v3 = malloc(sizeof(v3) * n_stream);
+  g_v4 = malloc(sizeof(v4) * n_stream);
+  g_o4 = malloc(sizeof(v4) * n_stream);
+  g_bytes = malloc((size_t)16 << 20);
+
+  for (int i = 0; i < n_batch; i++) {
+    g_a[i] = rng_m4();
+    g_b[i] = rng_m4();
+    g_p[i] = v3_mul(rng_v3(), 10);
+    g_d[i] = rng_v3();
+  }
+
+  for (int i = 0; i < n_stream; i++) g_v4[i] = (v4){rngf(), rngf(), rngf(), 1};
+  for (size_t i = 0; i < (size_t)16 << 20; i++) g_bytes[i] = (uint8_t)(rngf() * 127);
+
+  /* bytes read and written per op, 0 where ns/op is all that matters */
+  struct { void (*fn)(void); long n; double bytes; } runs[n_kernels] = {
+    {run_m4_mul, n_batch, sizeof(m4) * 3},
+    {run_m4_look, n_batch, 0},
+    {run_m4_persp, n_batch, 0},
+    {run_v3_normed, n_stream, sizeof(v3) * 2},
+    {run_v4_mul_m, n_stream, sizeof(v4) * 2},
+    {run_murmur3_16, n_batch, 0},
+    {run_murmur3_64k, 16, 65536},
+    {run_murmur3_16m, 1, 16 << 20},
+  };
+
+  struct kernel ks[n_kernels] = {
+    {"m4_mul"}, {"m4_look"}, {"m4_persp"}, {"v3_normed"},
+    {"v4_mul_m"}, {"hash_murmur3/16"}, {"hash_murmur3/64k"}, {"hash_murmur3/16m"},
+  };
+
+  double ref = INFINITY, base_ref = 0;
+  for (int r = 0; r < n_rounds; r++) {
+    ref = min(ref, best_ns(run_ref, n_stream, 0.01));
+    for (int i = 0; i < n_kernels; i++) {
+      ks[i].ns = min(r ? ks[i].ns : INFINITY, best_ns(runs[i].fn, runs[i].n, 0.04));
+    }
+  }
+
+  bool have_base = !update && load_baseline(path, ks, &base_ref) && base_ref > 0;
+  if (!update && !have_base) printf("no baseline at %s, run with --write-baseline to record one\n", path);
+  if (have_base) printf("reference loop %.3f ns/op, %.3f in the baseline\n", ref, base_ref);
+
+  int regressed = 0;
+  for (int i = 0; i < n_kernels; i++) {
+    struct kernel *k = &ks[i];
+    double pct = 0;
+    if (have_base && k->base > 0) {
+      /* as if this run's machine were as fast as the baseline's */
+      pct = (k->ns * base_ref / ref / k->base - 1) * 100;
+      for (int retry = 0; retry < 3 && pct > threshold; retry++) {
+        ref = min(ref, best_ns(run_ref, n_stream, 0.05));
+        k->ns = min(k->ns, best_ns(runs[i].fn, runs[i].n, 0.2));
+        pct = (k->ns * base_ref / ref / k->base - 1) * 100;
+      }
+    }
+
+    k->gbs = runs[i].bytes / k->ns;
+    printf("%-18s %12.3f ns/op", k->name, k->ns);
+    if (runs[i].bytes) printf(" %8.2f GB/s", k->gbs);
+    else printf("              ");
+
+    if (have_base && k->base > 0) {
+      bool bad = pct > threshold;
+      regressed += bad;
+      printf("  baseline %10.3f  %+6.1f%%%s", k->base, pct, bad ? "  REGRESSED" : "");
+    }
+
+    printf("\n");
+  }
+
+  if (update) {
+    store_baseline(path, ks, ref);
+    printf("wrote %s\n", path);
+  } else if (regressed) {
+    printf("%d kernel%s regressed by more than %.0f%%\n", regressed, regressed == 1 ? "" : "s", threshold);
+  }
+
+  return regressed != 0;
+}
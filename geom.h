@@ -0,0 +1,903 @@
+#pragma once
+
+#include "typedefs.h"
+
+struct vt {
+  v3 p, n;
+};
+
+/*-- welding --*/
+
+/**
+ * merges bitwise identical vertices. v is compacted in place to its unique
+ * vertices in first-seen order and n_v updated; the returned list has one
+ * index per original vertex
+ */
+static uint32_t *
+geom_weld(struct vt *v, int *n_v) {
+  int n = *n_v;
+  uint32_t *inds = malloc(sizeof(uint32_t) * max(n, 1));
+
+  size_t cap = 16;
+  while (cap < (size_t)n * 2) cap *= 2;
+  int *tab = malloc(sizeof(int) * cap);
+  memset(tab, 0xff, sizeof(int) * cap);
+
+  int nu = 0;
+  for (int i = 0; i < n; i++) {
+    size_t h = hash_murmur3(&v[i], sizeof(struct vt)) & (cap - 1);
+    while (tab[h] >= 0 && memcmp(&v[tab[h]], &v[i], sizeof(struct vt)) != 0) {
+      h = (h + 1) & (cap - 1);
+    }
+
+    if (tab[h] < 0) {
+      tab[h] = nu;
+      v[nu++] = v[i];
+    }
+
+    inds[i] = tab[h];
+  }
+
+  free(tab);
+  *n_v = nu;
+  return inds;
+}
+
+/**
+ * rewrites 32-bit indices as 16-bit ones in place when every vertex fits,
+ * returning the index size in bytes
+ */
+static int
+geom_narrow(uint32_t *inds, int n_inds, int n_v) {
+  if (n_v > 0xffff + 1) return sizeof(uint32_t);
+
+  uint16_t *dst = (uint16_t *)inds;
+  for (int i = 0; i < n_inds; i++) {
+    dst[i] = (uint16_t)inds[i];
+  }
+
+  return sizeof(uint16_t);
+}
+
+/*-- vertex cache --*/
+
+/**
+ * fifo size the optimizer targets and the stats simulate
+ */
+enum { geom_cache = 16 };
+
+/**
+ * simulates a fifo post-transform cache over the index list. acmr is
+ * misses per triangle (3 means no reuse, ~0.5 is ideal), atvr is misses
+ * per vertex (1 is ideal)
+ */
+static void
+geom_cache_stats(uint32_t const *inds, int n_inds, int n_v, float *acmr, float *atvr) {
+  int *stamp = calloc(max(n_v, 1), sizeof(int));
+
+  int t = 0;
+  for (int i = 0; i < n_inds; i++) {
+    uint32_t v = inds[i];
+    if (stamp[v] == 0 || t - stamp[v] >= geom_cache) stamp[v] = ++t;
+  }
+
+  free(stamp);
+  *acmr = n_inds ? (float)t / (n_inds / 3) : 0;
+  *atvr = n_v ? (float)t / n_v : 0;
+}
+
+/**
+ * tipsify (sander, nehab, barczak 2007): fans around the most recently
+ * cached vertex that will stay cached, and jumps to a dead-end vertex when
+ * none will. every jump starts a new cluster; bounds gets the first
+ * triangle of each one plus n_inds / 3 at the end, so it needs room for
+ * n_inds / 3 + 1 entries. bounds may be NULL
+ */
+static void
+geom_tipsify(uint32_t *inds, int n_inds, int n_v, int *bounds, int *n_bounds) {
+  int n_t = n_inds / 3;
+
+  int *off = calloc(n_v + 1, sizeof(int));
+  for (int i = 0; i < n_inds; i++) off[inds[i] + 1]++;
+  for (int i = 0; i < n_v; i++) off[i + 1] += off[i];
+
+  int *adj = malloc(sizeof(int) * max(n_inds, 1));
+  int *live = malloc(sizeof(int) * max(n_v, 1));
+  memcpy(live, off, sizeof(int) * n_v);
+  for (int i = 0; i < n_inds; i++) adj[live[inds[i]]++] = i / 3;
+  for (int i = 0; i < n_v; i++) live[i] = off[i + 1] - off[i];
+
+  int *stamp = calloc(max(n_v, 1), sizeof(int));
+  bool *done = calloc(max(n_t, 1), sizeof(bool));
+  uint32_t *dead = malloc(sizeof(uint32_t) * max(n_inds, 1));
+  uint32_t *out = malloc(sizeof(uint32_t) * max(n_inds, 1));
+
+  int s = geom_cache + 1, cursor = 0, nd = 0, no = 0, nb = 0;
+  int f = n_v ? 0 : -1;
+
+  if (bounds) bounds[nb++] = 0;
+
+  while (f >= 0) {
+    int fan = nd;
+    for (int a = off[f]; a < off[f + 1]; a++) {
+      int t = adj[a];
+      if (done[t]) continue;
+
+      for (int j = 0; j < 3; j++) {
+        uint32_t v = inds[t * 3 + j];
+        out[no++] = v;
+        dead[nd++] = v;
+        live[v]--;
+        if (s - stamp[v] > geom_cache) stamp[v] = s++;
+      }
+
+      done[t] = true;
+    }
+
+    int best = -1, score = -1;
+    for (int c = fan; c < nd; c++) {
+      uint32_t v = dead[c];
+      if (live[v] <= 0) continue;
+
+      int p = s - stamp[v] + 2 * live[v] <= geom_cache ? s - stamp[v] : 0;
+      if (p > score) score = p, best = (int)v;
+    }
+
+    if (best < 0) {
+      while (nd > 0 && best < 0) {
+        uint32_t v = dead[--nd];
+        if (live[v] > 0) best = (int)v;
+      }
+
+      for (; best < 0 && cursor < n_v; cursor++) {
+        if (live[cursor] > 0) best = cursor;
+      }
+
+      if (bounds && best >= 0 && bounds[nb - 1] != no / 3) bounds[nb++] = no / 3;
+    }
+
+    f = best;
+  }
+
+  if (bounds) {
+    if (nb > 1 && bounds[nb - 1] == n_t) nb--;
+    bounds[nb] = n_t;
+    *n_bounds = nb;
+  }
+
+  memcpy(inds, out, sizeof(uint32_t) * no);
+
+  free(off);
+  free(adj);
+  free(live);
+  free(stamp);
+  free(done);
+  free(dead);
+  free(out);
+}
+
+struct geom_cluster {
+  float key;
+  int beg, end;
+};
+
+static int
+geom_cluster_cmp(void const *a, void const *b) {
+  float ka = ((struct geom_cluster const *)a)->key;
+  float kb = ((struct geom_cluster const *)b)->key;
+  return (ka < kb) - (ka > kb);
+}
+
+/**
+ * overdraw ordering on top of tipsify's clusters (sander et al.'s fast
+ * triangle reordering). clusters are first split wherever a cold-cache
+ * restart would cost no more than threshold times the mesh's acmr, then
+ * drawn in order of how far they face out from the mesh centroid, so the
+ * outer shell lands in the depth buffer first
+ */
+static void
+geom_overdraw(uint32_t *inds, int n_inds, struct vt const *v, int n_v, int const *bounds, int n_bounds, float threshold) {
+  int n_t = n_inds / 3;
+
+  float acmr, atvr;
+  geom_cache_stats(inds, n_inds, n_v, &acmr, &atvr);
+
+  struct geom_cluster *cl = malloc(sizeof(struct geom_cluster) * max(n_t, 1));
+  int *stamp = calloc(max(n_v, 1), sizeof(int));
+  int nc = 0, clock = 0;
+
+  int beg = 0, misses = 0;
+  for (int b = 0; b < n_bounds; b++) {
+    for (int t = bounds[b]; t < bounds[b + 1]; t++) {
+      for (int j = 0; j < 3; j++) {
+        uint32_t i = inds[t * 3 + j];
+        if (stamp[i] == 0 || clock - stamp[i] >= geom_cache) stamp[i] = ++clock, misses++;
+      }
+    }
+
+    int end = bounds[b + 1];
+    if (end == n_t || misses <= threshold * acmr * (end - beg)) {
+      cl[nc++] = (struct geom_cluster){.beg = beg, .end = end};
+      beg = end, misses = 0;
+      clock += geom_cache + 1;
+    }
+  }
+
+  free(stamp);
+
+  v3 *cen = malloc(sizeof(v3) * max(nc, 1)), mid = v3_zero;
+  v3 *nrm = malloc(sizeof(v3) * max(nc, 1));
+  float area = 0;
+
+  for (int c = 0; c < nc; c++) {
+    cen[c] = nrm[c] = v3_zero;
+    float a = 0;
+    for (int t = cl[c].beg; t < cl[c].end; t++) {
+      v3 p0 = v[inds[t * 3]].p, p1 = v[inds[t * 3 + 1]].p, p2 = v[inds[t * 3 + 2]].p;
+      v3 n = v3_cross(v3_sub(p1, p0), v3_sub(p2, p0));
+      float ta = v3_len(n);
+
+      v3_inc(&cen[c], v3_mul(v3_add(v3_add(p0, p1), p2), ta / 3));
+      v3_inc(&nrm[c], n);
+      a += ta;
+    }
+
+    v3_inc(&mid, cen[c]);
+    area += a;
+    cen[c] = a > 0 ? v3_div(cen[c], a) : v[inds[cl[c].beg * 3]].p;
+  }
+
+  if (area > 0) mid = v3_div(mid, area);
+
+  for (int c = 0; c < nc; c++) {
+    float len = v3_len(nrm[c]);
+    cl[c].key = len > 0 ? v3_dot(v3_sub(cen[c], mid), v3_div(nrm[c], len)) : -INFINITY;
+  }
+
+  qsort(cl, nc, sizeof(*cl), geom_cluster_cmp);
+
+  uint32_t *out = malloc(sizeof(uint32_t) * max(n_inds, 1));
+  int no = 0;
+  for (int c = 0; c < nc; c++) {
+    int n = (cl[c].end - cl[c].beg) * 3;
+    memcpy(out + no, inds + cl[c].beg * 3, sizeof(uint32_t) * n);
+    no += n;
+  }
+
+  memcpy(inds, out, sizeof(uint32_t) * n_inds);
+
+  free(out);
+  free(cen);
+  free(nrm);
+  free(cl);
+}
+
+/**
+ * renumbers vertices in order of first use so fetches walk the vertex
+ * buffer forwards. unreferenced vertices are dropped; returns the new
+ * vertex count
+ */
+static int
+geom_fetch(uint32_t *inds, int n_inds, struct vt *v, int n_v) {
+  uint32_t *remap = malloc(sizeof(uint32_t) * max(n_v, 1));
+  memset(remap, 0xff, sizeof(uint32_t) * n_v);
+  struct vt *out = malloc(sizeof(struct vt) * max(n_v, 1));
+
+  uint32_t nu = 0;
+  for (int i = 0; i < n_inds; i++) {
+    uint32_t k = inds[i];
+    if (remap[k] == UINT32_MAX) {
+      out[nu] = v[k];
+      remap[k] = nu++;
+    }
+
+    inds[i] = remap[k];
+  }
+
+  memcpy(v, out, sizeof(struct vt) * nu);
+  free(out);
+  free(remap);
+  return (int)nu;
+}
+
+/*-- simplification --*/
+
+/**
+ * most levels per mesh, counting the full-detail one
+ */
+enum { geom_max_lods = 5 };
+
+/**
+ * quadric over the 6d point (position, normal * weight), garland and
+ * heckbert's generalized form. a is the upper triangle of the 6x6 matrix;
+ * everything is scaled by the triangle areas summed in w, so cost / w is
+ * a mean squared distance
+ */
+struct geom_quadric {
+  double a[21], b[6], c, w;
+};
+
+static void
+geom_quadric_add(struct geom_quadric *dst, struct geom_quadric const *q) {
+  for (int i = 0; i < 21; i++) dst->a[i] += q->a[i];
+  for (int i = 0; i < 6; i++) dst->b[i] += q->b[i];
+  dst->c += q->c;
+  dst->w += q->w;
+}
+
+static double
+geom_quadric_eval(struct geom_quadric const *q, double const x[6]) {
+  double r = q->c;
+  for (int i = 0, k = 0; i < 6; i++) {
+    r += 2 * q->b[i] * x[i] + q->a[k++] * x[i] * x[i];
+    for (int j = i + 1; j < 6; j++) r += 2 * q->a[k++] * x[i] * x[j];
+  }
+
+  return r;
+}
+
+/**
+ * the quadric of the plane through p, q and r in 6d, weighted by area
+ */
+static void
+geom_quadric_tri(struct geom_quadric *dst, double const p[6], double const q[6], double const r[6], double area) {
+  double e1[6], e2[6], l1 = 0, l2 = 0, d = 0;
+  for (int i = 0; i < 6; i++) e1[i] = q[i] - p[i], l1 += e1[i] * e1[i];
+  l1 = sqrt(l1);
+
+  *dst = (struct geom_quadric){.w = area};
+  if (l1 == 0 || area == 0) return;
+
+  for (int i = 0; i < 6; i++) e1[i] /= l1, e2[i] = r[i] - p[i], d += e1[i] * e2[i];
+  for (int i = 0; i < 6; i++) e2[i] -= d * e1[i], l2 += e2[i] * e2[i];
+  l2 = sqrt(l2);
+  if (l2 == 0) return;
+
+  double pe1 = 0, pe2 = 0, pp = 0;
+  for (int i = 0; i < 6; i++) {
+    e2[i] /= l2;
+    pe1 += p[i] * e1[i], pe2 += p[i] * e2[i], pp += p[i] * p[i];
+  }
+
+  for (int i = 0, k = 0; i < 6; i++) {
+    for (int j = i; j < 6; j++, k++) {
+      dst->a[k] = area * ((i == j) - e1[i] * e1[j] - e2[i] * e2[j]);
+    }
+
+    dst->b[i] = area * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+  }
+
+  dst->c = area * (pp - pe1 * pe1 - pe2 * pe2);
+}
+
+/**
+ * the quadric of the plane through p with normal n, in positions only.
+ * keeps open edges from drifting off their line
+ */
+static void
+geom_quadric_plane(struct geom_quadric *dst, v3 p, v3 n, double weight) {
+  double d = -v3_dot(n, p);
+  *dst = (struct geom_quadric){.c = weight * d * d};
+  for (int i = 0, k = 0; i < 6; i++) {
+    for (int j = i; j < 6; j++, k++) {
+      if (j < 3) dst->a[k] = weight * n.v[i] * n.v[j];
+    }
+
+    if (i < 3) dst->b[i] = weight * d * n.v[i];
+  }
+}
+
+struct geom_collapse {
+  float err;
+  int from, to;
+};
+
+static int
+geom_collapse_cmp(void const *a, void const *b) {
+  float ea = ((struct geom_collapse const *)a)->err;
+  float eb = ((struct geom_collapse const *)b)->err;
+  return (ea > eb) - (ea < eb);
+}
+
+/**
+ * positions shared by several vertices (seams, where normals differ) get
+ * one id, the lowest vertex with that position. at[at_off[p]..at_off[p+1]]
+ * lists the vertices at position p
+ */
+static int *
+geom_pos_ids(struct vt const *v, int n_v, int **at_off, int **at) {
+  size_t cap = 16;
+  while (cap < (size_t)n_v * 2) cap *= 2;
+
+  int *pos = malloc(sizeof(int) * max(n_v, 1));
+  int *tab = malloc(sizeof(int) * cap);
+  memset(tab, 0xff, sizeof(int) * cap);
+
+  *at_off = calloc(n_v + 1, sizeof(int));
+  for (int i = 0; i < n_v; i++) {
+    size_t h = hash_murmur3(&v[i].p, sizeof(v3)) & (cap - 1);
+    while (tab[h] >= 0 && memcmp(&v[tab[h]].p, &v[i].p, sizeof(v3)) != 0) h = (h + 1) & (cap - 1);
+    if (tab[h] < 0) tab[h] = i;
+    pos[i] = tab[h];
+    (*at_off)[pos[i] + 1]++;
+  }
+
+  free(tab);
+
+  for (int i = 0; i < n_v; i++) (*at_off)[i + 1] += (*at_off)[i];
+  *at = malloc(sizeof(int) * max(n_v, 1));
+  int *fill = malloc(sizeof(int) * max(n_v, 1));
+  memcpy(fill, *at_off, sizeof(int) * n_v);
+  for (int i = 0; i < n_v; i++) (*at)[fill[pos[i]]++] = i;
+
+  free(fill);
+  return pos;
+}
+
+/**
+ * half-edges between positions, for telling open edges (no reverse) apart
+ */
+struct geom_edges {
+  uint64_t *keys;
+  size_t cap;
+};
+
+static void
+geom_edges_build(struct geom_edges *e, uint32_t const *inds, int n_inds, int const *pos) {
+  e->cap = 16;
+  while (e->cap < (size_t)n_inds * 2) e->cap *= 2;
+  e->keys = realloc(e->keys, sizeof(uint64_t) * e->cap);
+  memset(e->keys, 0xff, sizeof(uint64_t) * e->cap);
+
+  for (int i = 0; i < n_inds; i++) {
+    uint64_t k = (uint64_t)pos[inds[i]] << 32 | (uint32_t)pos[inds[i - i % 3 + (i + 1) % 3]];
+    size_t h = hash_murmur3(&k, sizeof(k)) & (e->cap - 1);
+    while (e->keys[h] != UINT64_MAX && e->keys[h] != k) h = (h + 1) & (e->cap - 1);
+    e->keys[h] = k;
+  }
+}
+
+static bool
+geom_edges_has(struct geom_edges const *e, int a, int b) {
+  uint64_t k = (uint64_t)a << 32 | (uint32_t)b;
+  size_t h = hash_murmur3(&k, sizeof(k)) & (e->cap - 1);
+  while (e->keys[h] != UINT64_MAX && e->keys[h] != k) h = (h + 1) & (e->cap - 1);
+  return e->keys[h] == k;
+}
+
+/**
+ * the vertex at position b that vertex u at another position should
+ * become: the one with the closest normal
+ */
+static int
+geom_wedge(struct vt const *v, int const *at_off, int const *at, int u, int b) {
+  int best = at[at_off[b]];
+  float d = -INFINITY;
+  for (int i = at_off[b]; i < at_off[b + 1]; i++) {
+    float di = v3_dot(v[u].n, v[at[i]].n);
+    if (di > d) d = di, best = at[i];
+  }
+
+  return best;
+}
+
+/**
+ * builds up to n_errs coarser levels of the triangle list in one run of
+ * half-edge collapses, so every level indexes the same vertices.
+ *
+ * collapses work on positions: every vertex at the moving position goes
+ * to the vertex at the target with the closest normal, so seams simplify
+ * along with everything else. open edges only collapse along themselves
+ * and carry extra planes that hold them in place. each pass applies the
+ * cheapest collapses first, moves a position at most once and rejects
+ * anything that would flip a triangle.
+ *
+ * whenever the next collapse would cost more than errs[l] (a distance in
+ * mesh units), the current list becomes level l, unless it is within 15%
+ * of the previous level's size. nw weighs normals against positions.
+ * levels are written back to back to out, which needs room for
+ * n_inds * n_errs; off gets each level's start plus its end and err its
+ * largest collapse error. returns the number of levels
+ */
+static int
+geom_lod(uint32_t const *inds, int n_inds, struct vt const *v, int n_v, float const *errs, int n_errs, float nw,
+         uint32_t *out, int *off, float *err) {
+  int *at_off, *at;
+  int *pos = geom_pos_ids(v, n_v, &at_off, &at);
+
+  double (*x)[6] = malloc(sizeof(*x) * max(n_v, 1));
+  for (int i = 0; i < n_v; i++) {
+    x[i][0] = v[i].p.x, x[i][1] = v[i].p.y, x[i][2] = v[i].p.z;
+    x[i][3] = v[i].n.x * nw, x[i][4] = v[i].n.y * nw, x[i][5] = v[i].n.z * nw;
+  }
+
+  struct geom_edges edges = {0};
+  geom_edges_build(&edges, inds, n_inds, pos);
+
+  struct geom_quadric *q = calloc(max(n_v, 1), sizeof(struct geom_quadric));
+  for (int i = 0; i < n_inds; i += 3) {
+    uint32_t const *t = &inds[i];
+    v3 n = v3_cross(v3_sub(v[t[1]].p, v[t[0]].p), v3_sub(v[t[2]].p, v[t[0]].p));
+    double area = 0.5 * v3_len(n);
+
+    struct geom_quadric tq;
+    geom_quadric_tri(&tq, x[t[0]], x[t[1]], x[t[2]], area);
+    for (int k = 0; k < 3; k++) geom_quadric_add(&q[t[k]], &tq);
+
+    for (int k = 0; k < 3; k++) {
+      uint32_t a = t[k], b = t[(k + 1) % 3];
+      if (geom_edges_has(&edges, pos[b], pos[a])) continue;
+
+      v3 e = v3_sub(v[b].p, v[a].p);
+      v3 side = v3_cross(e, n);
+      float len = v3_len(side);
+      if (len == 0) continue;
+
+      geom_quadric_plane(&tq, v[a].p, v3_div(side, len), v3_dot(e, e) * 10);
+      tq.w = 0;
+      geom_quadric_add(&q[a], &tq);
+      geom_quadric_add(&q[b], &tq);
+    }
+  }
+
+  uint32_t *cur = malloc(sizeof(uint32_t) * max(n_inds, 1));
+  memcpy(cur, inds, sizeof(uint32_t) * n_inds);
+  int n_cur = n_inds;
+
+  int *adj_off = malloc(sizeof(int) * (n_v + 1));
+  int *adj = malloc(sizeof(int) * max(n_inds, 1));
+  int *stamp = calloc(max(n_v, 1), sizeof(int));
+  bool *open = malloc(sizeof(bool) * max(n_v, 1));
+  uint32_t *remap = malloc(sizeof(uint32_t) * max(n_v, 1));
+  struct geom_collapse *cand = malloc(sizeof(struct geom_collapse) * max(n_inds * 2, 1));
+
+  int n_lods = 0, n_out = 0, last = n_inds, pass = 0;
+  float worst = 0;
+
+  for (int l = 0; l < n_errs; l++) {
+    for (;;) {
+      pass++;
+
+      /* triangles around each position, and which positions are on open edges */
+      geom_edges_build(&edges, cur, n_cur, pos);
+      memset(open, 0, sizeof(bool) * n_v);
+      memset(adj_off, 0, sizeof(int) * (n_v + 1));
+      for (int i = 0; i < n_cur; i++) {
+        int a = pos[cur[i]], b = pos[cur[i - i % 3 + (i + 1) % 3]];
+        if (!geom_edges_has(&edges, b, a)) open[a] = open[b] = true;
+        adj_off[a + 1]++;
+      }
+
+      for (int i = 0; i < n_v; i++) adj_off[i + 1] += adj_off[i];
+      for (int i = 0; i < n_cur; i++) adj[adj_off[pos[cur[i]]]++] = i / 3;
+      for (int i = n_v; i > 0; i--) adj_off[i] = adj_off[i - 1];
+      adj_off[0] = 0;
+
+      int n_cand = 0;
+      for (int i = 0; i < n_cur; i++) {
+        int e[2] = {pos[cur[i]], pos[cur[i - i % 3 + (i + 1) % 3]]};
+        bool edge_open = !geom_edges_has(&edges, e[1], e[0]);
+
+        for (int k = 0; k < 2; k++) {
+          int a = e[k], b = e[k ^ 1];
+          if (a == b || (open[a] && !edge_open)) continue;
+
+          double c = 0, w = 0;
+          for (int j = at_off[a]; j < at_off[a + 1]; j++) {
+            int u = at[j], t = geom_wedge(v, at_off, at, u, b);
+            struct geom_quadric m = q[u];
+            geom_quadric_add(&m, &q[t]);
+            c += geom_quadric_eval(&m, x[t]);
+            w += m.w;
+          }
+
+          cand[n_cand++] = (struct geom_collapse){(float)sqrt(w > 0 ? max(c / w, 0.) : 0.), a, b};
+        }
+      }
+
+      qsort(cand, n_cand, sizeof(*cand), geom_collapse_cmp);
+
+      for (int i = 0; i < n_v; i++) remap[i] = i;
+
+      int applied = 0;
+      for (int c = 0; c < n_cand && cand[c].err <= errs[l]; c++) {
+        int a = cand[c].from, b = cand[c].to;
+        if (stamp[a] == pass || stamp[b] == pass) continue;
+
+        bool flips = false;
+        for (int j = adj_off[a]; j < adj_off[a + 1] && !flips; j++) {
+          uint32_t const *t = &cur[adj[j] * 3];
+          if (pos[t[0]] == b || pos[t[1]] == b || pos[t[2]] == b) continue;
+
+          v3 p[3], r[3];
+          for (int k = 0; k < 3; k++) {
+            p[k] = v[t[k]].p;
+            r[k] = pos[t[k]] == a ? v[b].p : p[k];
+          }
+
+          v3 n0 = v3_cross(v3_sub(p[1], p[0]), v3_sub(p[2], p[0]));
+          v3 n1 = v3_cross(v3_sub(r[1], r[0]), v3_sub(r[2], r[0]));
+          flips = v3_dot(n0, n1) <= 0;
+        }
+
+        if (flips) continue;
+
+        for (int j = at_off[a]; j < at_off[a + 1]; j++) {
+          int u = at[j], t = geom_wedge(v, at_off, at, u, b);
+          remap[u] = t;
+          geom_quadric_add(&q[t], &q[u]);
+        }
+
+        worst = max(worst, cand[c].err);
+        applied++;
+
+        stamp[a] = stamp[b] = pass;
+        for (int j = adj_off[a]; j < adj_off[a + 1]; j++) {
+          uint32_t const *t = &cur[adj[j] * 3];
+          stamp[pos[t[0]]] = stamp[pos[t[1]]] = stamp[pos[t[2]]] = pass;
+        }
+      }
+
+      if (!applied) break;
+
+      int n = 0;
+      for (int i = 0; i < n_cur; i += 3) {
+        uint32_t a = remap[cur[i]], b = remap[cur[i + 1]], c = remap[cur[i + 2]];
+        if (pos[a] == pos[b] || pos[b] == pos[c] || pos[c] == pos[a]) continue;
+        cur[n++] = a, cur[n++] = b, cur[n++] = c;
+      }
+
+      n_cur = n;
+    }
+
+    if (n_cur == 0 || n_cur > last * 0.85f) continue;
+
+    off[n_lods] = n_out;
+    err[n_lods++] = worst;
+    memcpy(out + n_out, cur, sizeof(uint32_t) * n_cur);
+    n_out += n_cur;
+    last = n_cur;
+  }
+
+  off[n_lods] = n_out;
+
+  free(cand);
+  free(remap);
+  free(open);
+  free(stamp);
+  free(adj);
+  free(adj_off);
+  free(cur);
+  free(edges.keys);
+  free(q);
+  free(x);
+  free(at);
+  free(at_off);
+  free(pos);
+  return n_lods;
+}
+
+/*-- quantization --*/
+
+/**
+ * packed vertex: position as 16-bit unorm within the mesh bounds (the
+ * fourth component only pads to 8 bytes), normal as 10:10:10:2 snorm
+ */
+struct vtq {
+  uint16_t p[4];
+  uint32_t n;
+};
+
+[[gnu::always_inline]]
+
+inline static uint32_t
+geom_snorm10(float f) {
+  return (uint32_t)lrintf(clamp(f, -1, 1) * 511) & 0x3ff;
+}
+
+static void
+geom_quantize(struct vt const *v, int n, v3 lo, v3 hi, struct vtq *out) {
+  v3 ext = v3_sub(hi, lo), scale;
+  for (int i = 0; i < 3; i++) {
+    scale.v[i] = ext.v[i] > 0 ? 65535 / ext.v[i] : 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    v3 p = v3_mul_v(v3_sub(v[i].p, lo), scale);
+    out[i] = (struct vtq){
+      .p = {
+        (uint16_t)lrintf(clamp(p.x, 0, 65535)),
+        (uint16_t)lrintf(clamp(p.y, 0, 65535)),
+        (uint16_t)lrintf(clamp(p.z, 0, 65535)),
+      },
+      .n = geom_snorm10(v[i].n.x) | geom_snorm10(v[i].n.y) << 10 | geom_snorm10(v[i].n.z) << 20,
+    };
+  }
+}
+
+/*-- clusters --*/
+
+enum { geom_cl_verts = 64, geom_cl_tris = 124 };
+
+/**
+ * meshlets as a structure of arrays, so a culling pass only streams the
+ * fields it tests. cluster i is the contiguous run of triangles tri[i] to
+ * tri[i + 1] of the index buffer, which keeps the cache order intact and
+ * lets visible runs be drawn straight from the existing buffer. the cone
+ * is the axis of the triangle normals and the cosine of their largest
+ * angle from it; cut <= 0 means the cluster can't be backface culled
+ */
+struct geom_clusters {
+  int n;
+  int *tri;
+  float *cx, *cy, *cz, *r;
+  float *lox, *loy, *loz, *hix, *hiy, *hiz;
+  float *ax, *ay, *az, *cut;
+};
+
+[[gnu::always_inline]]
+
+inline static uint32_t
+geom_ind(void const *inds, int ind_size, int i) {
+  return ind_size == 2 ? ((uint16_t const *)inds)[i] : ((uint32_t const *)inds)[i];
+}
+
+static void
+geom_clusters_free(struct geom_clusters *c) {
+  free(c->tri);
+  free(c->cx);
+  *c = (struct geom_clusters){0};
+}
+
+/**
+ * splits the index list, in its current order, wherever the next triangle
+ * would take a cluster past geom_cl_verts or geom_cl_tris. run it after
+ * the vertex cache pass, whose order is already spatially coherent. p is
+ * the decoded position of every vertex
+ */
+static void
+geom_clusters_build(struct geom_clusters *dst, void const *inds, int ind_size, int n_inds, v3 const *p, int n_v) {
+  int n_t = n_inds / 3;
+  int *stamp = calloc(max(n_v, 1), sizeof(int));
+
+  int ntri = 0, ctri = 4;
+  int *tri = malloc(sizeof(int) * ctri);
+
+  int id = 0, nv = 0, nt = geom_cl_tris;
+  for (int t = 0; t < n_t; t++) {
+    uint32_t a = geom_ind(inds, ind_size, t * 3);
+    uint32_t b = geom_ind(inds, ind_size, t * 3 + 1);
+    uint32_t c = geom_ind(inds, ind_size, t * 3 + 2);
+    int fresh = (stamp[a] != id) + (stamp[b] != id && b != a) + (stamp[c] != id && c != a && c != b);
+
+    if (nv + fresh > geom_cl_verts || nt == geom_cl_tris) {
+      resize(tri);
+      tri[ntri++] = t;
+      id++, nv = nt = 0;
+      fresh = 1 + (b != a) + (c != a && c != b);
+    }
+
+    stamp[a] = stamp[b] = stamp[c] = id;
+    nv += fresh;
+    nt++;
+  }
+
+  free(stamp);
+
+  int n = ntri;
+  *dst = (struct geom_clusters){.n = n};
+  dst->tri = realloc(tri, sizeof(int) * (n + 1));
+  dst->tri[n] = n_t;
+
+  float *f = malloc(sizeof(float) * 14 * max(n, 1));
+  float **cols[] = {
+    &dst->cx, &dst->cy, &dst->cz, &dst->r,
+    &dst->lox, &dst->loy, &dst->loz, &dst->hix, &dst->hiy, &dst->hiz,
+    &dst->ax, &dst->ay, &dst->az, &dst->cut,
+  };
+
+  for (int i = 0; i < 14; i++) {
+    *cols[i] = f + i * n;
+  }
+
+  for (int i = 0; i < n; i++) {
+    int beg = dst->tri[i] * 3, end = dst->tri[i + 1] * 3;
+
+    v3 lo = {INFINITY, INFINITY, INFINITY}, hi = v3_neg(lo), axis = v3_zero;
+    for (int j = beg; j < end; j += 3) {
+      v3 a = p[geom_ind(inds, ind_size, j)];
+      v3 b = p[geom_ind(inds, ind_size, j + 1)];
+      v3 c = p[geom_ind(inds, ind_size, j + 2)];
+      lo = v3_min(lo, v3_min(a, v3_min(b, c)));
+      hi = v3_max(hi, v3_max(a, v3_max(b, c)));
+
+      v3 fn = v3_cross(v3_sub(b, a), v3_sub(c, a));
+      float l = v3_len(fn);
+      if (l > 0) axis = v3_add(axis, v3_div(fn, l));
+    }
+
+    v3 mid = v3_mul(v3_add(lo, hi), 0.5f);
+    float r = 0, cut = 1, l = v3_len(axis);
+    axis = l > 0 ? v3_div(axis, l) : v3_zero;
+
+    for (int j = beg; j < end; j += 3) {
+      v3 a = p[geom_ind(inds, ind_size, j)];
+      v3 b = p[geom_ind(inds, ind_size, j + 1)];
+      v3 c = p[geom_ind(inds, ind_size, j + 2)];
+      r = max(r, max(v3_dist(mid, a), max(v3_dist(mid, b), v3_dist(mid, c))));
+
+      v3 fn = v3_cross(v3_sub(b, a), v3_sub(c, a));
+      float fl = v3_len(fn);
+      if (fl > 0) cut = min(cut, v3_dot(axis, fn) / fl);
+    }
+
+    dst->cx[i] = mid.x, dst->cy[i] = mid.y, dst->cz[i] = mid.z, dst->r[i] = r;
+    dst->lox[i] = lo.x, dst->loy[i] = lo.y, dst->loz[i] = lo.z;
+    dst->hix[i] = hi.x, dst->hiy[i] = hi.y, dst->hiz[i] = hi.z;
+    dst->ax[i] = axis.x, dst->ay[i] = axis.y, dst->az[i] = axis.z;
+    dst->cut[i] = l > 0 ? cut : -1;
+  }
+}
+
+/**
+ * the six clip planes of a view-projection (row vectors, as m4_mul builds
+ * them), normalized so distances come out in world units
+ */
+static void
+geom_frustum(m4 vp, v4 planes[6]) {
+  v4 w = m4_col(&vp, 3);
+  for (int i = 0; i < 3; i++) {
+    v4 c = m4_col(&vp, i);
+    planes[i * 2] = v4_add(w, c);
+    planes[i * 2 + 1] = v4_sub(w, c);
+  }
+
+  for (int i = 0; i < 6; i++) {
+    planes[i] = v4_div(planes[i], v3_len((v3){planes[i].x, planes[i].y, planes[i].z}));
+  }
+}
+
+[[gnu::always_inline]]
+
+inline static bool
+geom_cl_outside(struct geom_clusters const *c, int i, v4 const planes[6]) {
+  for (int j = 0; j < 6; j++) {
+    v4 pl = planes[j];
+    if (pl.x * c->cx[i] + pl.y * c->cy[i] + pl.z * c->cz[i] + pl.w < -c->r[i]) return true;
+  }
+
+  return false;
+}
+
+[[gnu::always_inline]]
+
+inline static bool
+geom_sphere_outside(v3 c, float r, v4 const planes[6]) {
+  for (int j = 0; j < 6; j++) {
+    v4 pl = planes[j];
+    if (pl.x * c.x + pl.y * c.y + pl.z * c.z + pl.w < -r) return true;
+  }
+
+  return false;
+}
+
+/**
+ * true when every triangle faces away from eye, wherever it lies within
+ * the sphere: the nearest a cone normal gets to the view direction still
+ * has to clear the sphere's radius
+ */
+[[gnu::always_inline]]
+
+inline static bool
+geom_cl_backfacing(struct geom_clusters const *c, int i, v3 eye) {
+  if (c->cut[i] <= 0) return false;
+
+  v3 d = {c->cx[i] - eye.x, c->cy[i] - eye.y, c->cz[i] - eye.z};
+  float dl = v3_len(d);
+  if (dl <= c->r[i]) return false;
+
+  float cos_a = (c->ax[i] * d.x + c->ay[i] * d.y + c->az[i] * d.z) / dl;
+  float sin_a = sqrtf(max(1 - cos_a * cos_a, 0.f));
+  float sin_t = sqrtf(max(1 - c->cut[i] * c->cut[i], 0.f));
+  return cos_a * c->cut[i] - sin_a * sin_t > c->r[i] / dl;
+}
@@ -42,6 +42,6 @@ typedef struct _GLFWtlsPOSIX {
 //
 typedef struct _GLFWmutexPOSIX {
   GLFWbool allocated;
-  pthread_mustruct tex handle;
+  pthread_mutex_t handle;
 } _GLFWmutexPOSIX;
 
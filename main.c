@@ -1,14 +1,25 @@
+#ifdef _WIN32
 #include "Windows.h"
+#endif
 #include <stdio.h>
+#include <stdarg.h>
 #include "typedefs.h"
+#include "obj.h"
+#include "prof.h"
 #include <GLFW/glfw3.h>
 #include "lib/glad/glad.h"
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include <stdatomic.h>
 #include "stb_truetype.h"
+#include "stb_image_write.h"
+#ifdef HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
+#ifdef _WIN32
 __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 __declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
+#endif
 
 /*-- typedefs --*/
 
@@ -23,302 +34,2120 @@ int g_w = 2304, g_h = 2304;
 enum state g_state = s_title;
 struct camera camera;
 struct shader lines, points, bary, norm, lit, lines_transition;
-struct mesh mesh;
+struct shader points_pull, lines_pull, bary_pull;
+struct mesh mesh, tree;
 int g_n = 0;
+bool g_pull;
+struct shader *g_modes[2][5] = {
+  {&points, &lines, &bary, &norm, &lit},
+  {&points_pull, &lines_pull, &bary_pull, &norm, &lit},
+};
+char const *g_mode_names[5] = {"points", "lines", "bary", "norm", "lit"};
 float g_t = 0;
+bool g_quant = true;
+size_t g_stream_budget = (size_t)256 << 20;
+bool g_cull = true;
+v4 g_frustum[6];
+bool g_lod = true;
+float g_lod_px = 1;
+float g_lod_scale;
+v3 g_eye;
+int64_t g_tris[2];
+int g_va;
+struct { int64_t draws, cmds, programs, vaos; } g_rq_stats;
+
+/*-- program binaries --*/
+
+enum { shader_key_len = 9 };
+
+/**
+ * ./cache/<hash of key>.bin: this header, then the binary as
+ * glGetProgramBinary returned it
+ */
+struct shader_bin_hdr {
+  char magic[4];
+  uint32_t key[shader_key_len];
+  uint32_t format, len;
+};
+
+int g_n_programs, g_n_cached;
+
+/**
+ * what a cached binary has to match: each stage's source hash and length,
+ * the defines, and the renderer and version, since a binary is only good
+ * for the driver that made it
+ */
+static void
+shader_key(uint32_t *key, char *const *srcs, size_t const *lens, char const *defs) {
+  for (int i = 0; i < 3; i++) {
+    key[i * 2] = srcs[i] ? hash_murmur3(srcs[i], lens[i]) : 0;
+    key[i * 2 + 1] = (uint32_t)lens[i];
+  }
+
+  char const *renderer = (char const *)gl_get_string(GL_RENDERER);
+  char const *version = (char const *)gl_get_string(GL_VERSION);
+  key[6] = hash_murmur3(defs, strlen(defs));
+  key[7] = hash_murmur3(renderer, strlen(renderer));
+  key[8] = hash_murmur3(version, strlen(version));
+}
+
+/**
+ * false if there's no binary for key or the driver rejects it, in which
+ * case prog is left unlinked
+ */
+static bool
+shader_bin_load(int prog, char const *path, uint32_t const *key) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return false;
+
+  struct shader_bin_hdr h;
+  bool ok = fread(&h, sizeof(h), 1, fp) == 1
+            && memcmp(h.magic, "PRGB", 4) == 0
+            && memcmp(h.key, key, sizeof(h.key)) == 0;
+
+  void *bin = ok ? malloc(h.len) : NULL;
+  ok = ok && fread(bin, 1, h.len, fp) == h.len;
+  fclose(fp);
+
+  if (ok) {
+    int status;
+    gl_program_binary(prog, h.format, bin, h.len);
+    gl_get_programiv(prog, GL_LINK_STATUS, &status);
+    ok = status == GL_TRUE;
+  }
+
+  free(bin);
+  return ok;
+}
+
+static void
+shader_bin_store(int prog, char const *path, uint32_t const *key) {
+  int n_formats = 0, len = 0;
+  gl_get_integerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  gl_get_programiv(prog, GL_PROGRAM_BINARY_LENGTH, &len);
+  if (n_formats == 0 || len <= 0) return;
+
+  struct shader_bin_hdr h = {.magic = {'P', 'R', 'G', 'B'}, .len = len};
+  memcpy(h.key, key, sizeof(h.key));
+  void *bin = malloc(len);
+  gl_get_program_binary(prog, len, NULL, &h.format, bin);
+
+  sys_mkdir("./cache");
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    fprintf(stderr, "shader: can't write %s\n", path);
+    free(bin);
+    return;
+  }
+
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(bin, 1, len, fp) == (size_t)len;
+  if (fclose(fp) != 0 || !ok) remove(path);
+  free(bin);
+}
 
 /*-- shaders --*/
 
 struct uni {
   char const *name;
-  int loc;
+  int loc, type;
 };
 
+/**
+ * resolved uniform locations, one type per GL type so a handle only fits
+ * its own setter. a location of -1 makes the setter a no-op
+ */
+typedef struct { int loc; } uni_1f;
+typedef struct { int loc; } uni_2f;
+typedef struct { int loc; } uni_3f;
+typedef struct { int loc; } uni_m4f;
+typedef struct { int loc; } uni_1i;
+
+/**
+ * tab is a perfect hash over unis: uni_hash(name, seed) & mask gives the
+ * only slot a name can be in. the handles below are resolved once by
+ * shader_finish; per-frame and per-draw data are in the buffers
+ * shaders/frame.glsl declares instead.
+ *
+ * until ready, the program may still be compiling: stages holds the
+ * shader objects to check and key what to cache the result under.
+ *
+ * programs that pull their vertices draw per_tri unindexed prim vertices
+ * for each triangle, and hand meshes they can't pull from to fallback
+ */
 struct shader {
   int id;
+  bool ready, cached;
+  int stages[3];
+  char const *paths[3];
+  uint32_t key[shader_key_len];
+
   int n_unis;
   struct uni *unis;
+  uint32_t seed, mask;
+  int *tab;
+
+  uni_1f t;
+  uni_1i fmt;
+
+  int per_tri, prim;
+  struct shader *fallback;
 };
 
+static uint32_t
+uni_hash(char const *name, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (; *name; name++) h = (h ^ (uint8_t)*name) * 16777619u;
+  return h ^ h >> 15;
+}
+
+/**
+ * tries seeds until every name lands in its own slot, growing the table
+ * if a few hundred don't do it
+ */
+static void
+shader_hash(struct shader *dst) {
+  int cap = 8;
+  while (cap < dst->n_unis * 2) cap *= 2;
+
+  for (uint32_t seed = 0;; seed++) {
+    if (seed && seed % 256 == 0) cap *= 2;
+
+    dst->tab = realloc(dst->tab, sizeof(int) * cap);
+    memset(dst->tab, 0xff, sizeof(int) * cap);
+
+    bool ok = true;
+    for (int i = 0; i < dst->n_unis && ok; i++) {
+      int *slot = &dst->tab[uni_hash(dst->unis[i].name, seed) & (cap - 1)];
+      ok = *slot < 0;
+      *slot = i;
+    }
+
+    if (ok) {
+      dst->seed = seed;
+      dst->mask = cap - 1;
+      return;
+    }
+  }
+}
+
+/**
+ * index of the active uniform called name, or -1
+ */
+int
+shader_find(struct shader const *s, char const *name) {
+  int i = s->tab[uni_hash(name, s->seed) & s->mask];
+  return i >= 0 && strcmp(s->unis[i].name, name) == 0 ? i : -1;
+}
+
+/**
+ * a uniform's location, checked against its GL type. misses are reported
+ * in debug builds unless quiet, for uniforms that only some variants use
+ */
+static int
+shader_loc(struct shader const *s, char const *name, int type, bool quiet) {
+  int i = shader_find(s, name);
+  if (i >= 0 && s->unis[i].type == type) return s->unis[i].loc;
+
+#ifndef NDEBUG
+  if (i >= 0) {
+    fprintf(stderr, "shader %d: uniform %s is type 0x%x, not 0x%x\n", s->id, name, s->unis[i].type, type);
+  } else if (!quiet) {
+    fprintf(stderr, "shader %d: no active uniform %s\n", s->id, name);
+  }
+#endif
+
+  return -1;
+}
+
+/**
+ * GL_KHR_parallel_shader_compile and the ARB version share their enums
+ */
+#define GL_MAX_SHADER_COMPILER_THREADS 0x91B0
+#define GL_COMPLETION_STATUS 0x91B1
+
+typedef void (*max_shader_compiler_threads_fn)(unsigned);
+
+bool g_parallel_compile;
+GLADloadproc g_get_proc;
+struct shader **g_pending;
+int g_n_pending, g_c_pending;
+double g_t_shaders;
+
+static bool
+gl_has_ext(char const *name) {
+  int n = 0;
+  gl_get_integerv(GL_NUM_EXTENSIONS, &n);
+  for (int i = 0; i < n; i++) {
+    if (strcmp((char const *)gl_get_stringi(GL_EXTENSIONS, i), name) == 0) return true;
+  }
+
+  return false;
+}
+
+/**
+ * lets the driver compile on as many threads as it likes, if it says so.
+ * without the extension the status queries in shader_finish still come
+ * after everything is submitted, which drivers with their own compile
+ * threads make use of anyway
+ */
+void
+shader_parallel_init(void) {
+  char const *exts[] = {"GL_KHR_parallel_shader_compile", "GL_ARB_parallel_shader_compile"};
+  char const *procs[] = {"glMaxShaderCompilerThreadsKHR", "glMaxShaderCompilerThreadsARB"};
+
+  for (int i = 0; i < 2 && !g_parallel_compile; i++) {
+    if (!gl_has_ext(exts[i])) continue;
+
+    max_shader_compiler_threads_fn fn = (max_shader_compiler_threads_fn)g_get_proc(procs[i]);
+    if (fn) {
+      fn(0xffffffffu);
+      g_parallel_compile = true;
+    }
+  }
+}
+
+/**
+ * queues the program's compile and link without waiting on either, so
+ * every shader_new can be in flight before the first status query.
+ * defs is spliced in after each stage's #version line, e.g. "#define QUANT\n".
+ * the linked program is kept in ./cache/ and reused while the sources,
+ * defs and driver stay the same
+ */
 void 
 shader_new(
     struct shader *dst, 
     char const *vsh, 
     char const *fsh, 
-    char const *gsh) {
-  size_t len;
-  char *src;
-  char buf[1024];
-  int vsh_id, fsh_id, gsh_id, status;
-  int prog = gl_create_program();
-
-#define one_shader(id, path, stage) \
-  id = gl_create_shader(stage); \
-  src = read_txt_file_len(path, &len); \
-\
-  gl_shader_source(id, 1, (char const *[]){src}, (int[]){len}); \
-  gl_compile_shader(id); \
-\
-  gl_get_shaderiv(id, GL_COMPILE_STATUS, &status); \
-  if (status == GL_FALSE) { \
-    gl_get_shader_info_log(id, sizeof(buf), NULL, buf); \
-    err("failed to compile shader %s because\n%s", path, buf); \
-  } \
-\
-  free(src); \
-  gl_attach_shader(prog, id);
+    char const *gsh,
+    char const *defs) {
+  prof_begin(zone, "shader_new");
+  int const types[3] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+  char *srcs[3] = {0};
+  size_t lens[3] = {0};
+
+  if (g_n_pending == 0) g_t_shaders = sys_time();
+
+  *dst = (struct shader){.paths = {vsh, fsh, gsh}};
+  for (int i = 0; i < 3; i++) {
+    if (dst->paths[i]) srcs[i] = read_txt_file_len(dst->paths[i], &lens[i]);
+  }
+
+  shader_key(dst->key, srcs, lens, defs);
+
+  char path[64];
+  snprintf(path, sizeof(path), "./cache/%08x.bin", hash_murmur3(dst->key, sizeof(dst->key)));
+
+  dst->id = gl_create_program();
+  g_n_programs++;
 
-  one_shader(vsh_id, vsh, GL_VERTEX_SHADER);
-  one_shader(fsh_id, fsh, GL_FRAGMENT_SHADER);
+  if (shader_bin_load(dst->id, path, dst->key)) {
+    dst->cached = true;
+    g_n_cached++;
+  } else {
+    gl_delete_program(dst->id);
+    dst->id = gl_create_program();
 
-  if (gsh) {
-    one_shader(gsh_id, gsh, GL_GEOMETRY_SHADER);
+    for (int i = 0; i < 3; i++) {
+      if (!srcs[i]) continue;
+
+      char const *src = srcs[i];
+      int len = (int)lens[i];
+      int head = strchr(src, '\n') ? strchr(src, '\n') + 1 - src : len;
+
+      dst->stages[i] = gl_create_shader(types[i]);
+      gl_shader_source(dst->stages[i], 3, (char const *[]){src, defs, src + head}, (int[]){head, strlen(defs), len - head});
+      gl_compile_shader(dst->stages[i]);
+      gl_attach_shader(dst->id, dst->stages[i]);
+    }
+
+    gl_program_parameteri(dst->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    gl_link_program(dst->id);
   }
 
-  gl_link_program(prog);
+  for (int i = 0; i < 3; i++) {
+    free(srcs[i]);
+  }
 
-  gl_get_programiv(prog, GL_LINK_STATUS, &status);
-  if (status == GL_FALSE) {
-    gl_get_program_info_log(prog, sizeof(buf), NULL, buf);
-    err("failed to link program\n%s", buf);
+  if (g_n_pending == g_c_pending) {
+    g_c_pending = max(g_c_pending * 2, 16);
+    g_pending = realloc(g_pending, sizeof(*g_pending) * g_c_pending);
   }
 
-  dst->id = prog;
+  g_pending[g_n_pending++] = dst;
+  prof_end(zone);
+}
+
+/**
+ * waits for the program if it's still compiling, reports errors, stores
+ * the binary and resolves the uniforms. does nothing once ready
+ */
+void
+shader_finish(struct shader *dst) {
+  if (dst->ready) return;
+  prof_begin(zone, "shader_finish");
+
+  char buf[1024];
+  int status;
+  int prog = dst->id;
+
+  if (!dst->cached) {
+    gl_get_programiv(prog, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+      for (int i = 0; i < 3; i++) {
+        if (!dst->stages[i]) continue;
+
+        gl_get_shaderiv(dst->stages[i], GL_COMPILE_STATUS, &status);
+        if (status == GL_FALSE) {
+          gl_get_shader_info_log(dst->stages[i], sizeof(buf), NULL, buf);
+          err("failed to compile shader %s because\n%s", dst->paths[i], buf);
+        }
+      }
+
+      gl_get_program_info_log(prog, sizeof(buf), NULL, buf);
+      err("failed to link program\n%s", buf);
+    }
+
+    for (int i = 0; i < 3; i++) {
+      if (!dst->stages[i]) continue;
+      gl_detach_shader(prog, dst->stages[i]);
+      gl_delete_shader(dst->stages[i]);
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "./cache/%08x.bin", hash_murmur3(dst->key, sizeof(dst->key)));
+    shader_bin_store(prog, path, dst->key);
+  }
 
   gl_get_programiv(prog, GL_ACTIVE_UNIFORMS, &status);
   dst->n_unis = status;
   dst->unis = malloc(sizeof(struct uni) * status);
+  dst->tab = NULL;
 
   for (int i = 0; i < status; i++) {
     int a;
-    gl_get_active_uniform(prog, i, sizeof(buf), &a, &a, &a, buf);
+    gl_get_active_uniform(prog, i, sizeof(buf), &a, &a, &dst->unis[i].type, buf);
     dst->unis[i].name = strdup(buf);
     dst->unis[i].loc = gl_get_uniform_location(prog, buf);
   }
 
-#undef one_shader
-}
+  shader_hash(dst);
+
+  dst->t = (uni_1f){shader_loc(dst, "u_t", GL_FLOAT, true)};
+  dst->fmt = (uni_1i){shader_loc(dst, "u_fmt", GL_INT, true)};
+  dst->ready = true;
+
+  for (int i = 0; i < g_n_pending; i++) {
+    if (g_pending[i] == dst) g_pending[i--] = g_pending[--g_n_pending];
+  }
+
+  if (g_n_pending == 0) {
+    printf("shaders: all %d linked after %.1f ms\n", g_n_programs, (sys_time() - g_t_shaders) * 1e3);
+  }
+  prof_end(zone);
+}
+
+/**
+ * finishes the programs the driver says are done, without blocking on the
+ * rest. only the parallel compile extension can tell
+ */
+void
+shaders_poll(void) {
+  if (!g_parallel_compile) return;
+
+  for (int i = g_n_pending - 1; i >= 0; i--) {
+    struct shader *s = g_pending[i];
+    int done = GL_TRUE;
+    if (!s->cached) gl_get_programiv(s->id, GL_COMPLETION_STATUS, &done);
+    if (done) shader_finish(s);
+  }
+}
+
+/**
+ * marks a shaders/pull.vsh program as drawing prim, per_tri vertices a
+ * triangle, with fallback for unindexed meshes
+ */
+void
+shader_pulls(struct shader *dst, int prim, int per_tri, struct shader *fallback) {
+  dst->prim = prim;
+  dst->per_tri = per_tri;
+  dst->fallback = fallback;
+}
+
+/**
+ * binds the program, finishing it first if nothing has yet
+ */
+void
+shader_use(struct shader *s) {
+  shader_finish(s);
+  gl_use_program(s->id);
+}
+
+uni_1f
+shader_uni_1f(struct shader *s, char const *name) {
+  return (uni_1f){shader_loc(s, name, GL_FLOAT, false)};
+}
+
+uni_2f
+shader_uni_2f(struct shader *s, char const *name) {
+  return (uni_2f){shader_loc(s, name, GL_FLOAT_VEC2, false)};
+}
+
+uni_3f
+shader_uni_3f(struct shader *s, char const *name) {
+  return (uni_3f){shader_loc(s, name, GL_FLOAT_VEC3, false)};
+}
+
+uni_m4f
+shader_uni_m4f(struct shader *s, char const *name) {
+  return (uni_m4f){shader_loc(s, name, GL_FLOAT_MAT4, false)};
+}
+
+void
+shader_put_m4f(struct shader *dst, uni_m4f u, m4 *m) {
+  gl_program_uniform_matrix_4fv(dst->id, u.loc, 1, GL_TRUE, &m->_00);
+}
+
+void
+shader_put_1f(struct shader *dst, uni_1f u, float v) {
+  gl_program_uniform_1f(dst->id, u.loc, v);
+}
+
+void
+shader_put_3f(struct shader *dst, uni_3f u, v3 v) {
+  gl_program_uniform_3f(dst->id, u.loc, v.x, v.y, v.z);
+}
+
+void
+shader_put_2f(struct shader *dst, uni_2f u, v2 v) {
+  gl_program_uniform_2f(dst->id, u.loc, v.x, v.y);
+}
+
+void
+shader_put_1i(struct shader *dst, uni_1i u, int v) {
+  gl_program_uniform_1i(dst->id, u.loc, v);
+}
+
+/**
+ * by name, for one-off sets. anything per frame should hold a handle
+ */
+void
+shader_set_m4f(struct shader *dst, char const *name, m4 *m) {
+  shader_put_m4f(dst, shader_uni_m4f(dst, name), m);
+}
+
+void
+shader_set_1f(struct shader *dst, char const *name, float v) {
+  shader_put_1f(dst, shader_uni_1f(dst, name), v);
+}
+
+void
+shader_set_3f(struct shader *dst, char const *name, v3 v) {
+  shader_put_3f(dst, shader_uni_3f(dst, name), v);
+}
+
+void
+shader_set_2f(struct shader *dst, char const *name, v2 v) {
+  shader_put_2f(dst, shader_uni_2f(dst, name), v);
+}
+
+/*-- meshes --*/
+
+enum attr {
+  attr_1f,
+  attr_2f,
+  attr_3f,
+  attr_4f,
+  attr_3us_n,
+  attr_1010102_n
+};
+
+/**
+ * components, type, normalized and size in the vertex for each attr.
+ * attr_3us_n pads to 8 bytes to keep the next attribute aligned
+ */
+static struct {
+  int n, type, norm, size;
+} const attr_fmt[] = {
+  [attr_1f] = {1, GL_FLOAT, GL_FALSE, 4},
+  [attr_2f] = {2, GL_FLOAT, GL_FALSE, 8},
+  [attr_3f] = {3, GL_FLOAT, GL_FALSE, 12},
+  [attr_4f] = {4, GL_FLOAT, GL_FALSE, 16},
+  [attr_3us_n] = {3, GL_UNSIGNED_SHORT, GL_TRUE, 8},
+  [attr_1010102_n] = {4, GL_INT_2_10_10_10_REV, GL_TRUE, 4},
+};
+
+/**
+ * points va's attributes 0..n-1 at binding 0, packed in order. returns
+ * the stride
+ */
+static int
+vertex_array_attrs(int va, int n, enum attr const *attrs) {
+  int off = 0;
+  for (int i = 0; i < n; i++) {
+    gl_enable_vertex_array_attrib(va, i);
+    gl_vertex_array_attrib_format(va, i, attr_fmt[attrs[i]].n, attr_fmt[attrs[i]].type, attr_fmt[attrs[i]].norm, off);
+    gl_vertex_array_attrib_binding(va, i, 0);
+    off += attr_fmt[attrs[i]].size;
+  }
+
+  return off;
+}
+
+struct mesh_gpu {
+  int va, vb, ib;
+};
+
+void
+mesh_gpu_new(struct mesh_gpu *dst, int n, ...) {
+  gl_create_vertex_arrays(1, &dst->va);
+  gl_create_buffers(1, &dst->vb);
+  gl_create_buffers(1, &dst->ib);
+
+  enum attr attrs[n];
+
+  va_list va;
+  va_start(va, n);
+  for (int i = 0; i < n; i++) {
+    attrs[i] = va_arg(va, enum attr);
+  }
+
+  va_end(va);
+
+  int stride = vertex_array_attrs(dst->va, n, attrs);
+  gl_vertex_array_vertex_buffer(dst->va, 0, dst->vb, 0, stride);
+  gl_vertex_array_element_buffer(dst->va, dst->ib);
+}
+
+/*-- arenas --*/
+
+/**
+ * a live range of an arena. where points at the owner's copy of off, which
+ * growing and compacting keep up to date
+ */
+struct arena_block {
+  int off, n;
+  int *where;
+};
+
+/**
+ * one GL buffer handed out in ranges of unit bytes. blocks are sorted by
+ * offset and allocation is first fit over the gaps between them. when
+ * nothing fits the buffer doubles, packing the blocks as they're copied
+ * over, and frees that leave more than half of it in gaps pack it in place
+ */
+struct arena {
+  int buf, unit;
+  int cap, top, used;
+  struct arena_block *blocks;
+  int n_blocks, c_blocks;
+};
+
+/**
+ * copies the blocks into a new buffer of cap units, packed to the front
+ * if pack, and swaps it in. GL buffers can't copy between overlapping
+ * ranges of themselves, so compacting goes through a new buffer too
+ */
+static void
+arena_move(struct arena *a, int cap, bool pack) {
+  int buf;
+  gl_create_buffers(1, &buf);
+  gl_named_buffer_storage(buf, (size_t)cap * a->unit, NULL, GL_DYNAMIC_STORAGE_BIT);
+
+  int top = 0;
+  for (int i = 0; i < a->n_blocks; i++) {
+    struct arena_block *b = &a->blocks[i];
+    int off = pack ? top : b->off;
+    if (b->n) {
+      gl_copy_named_buffer_sub_data(a->buf, buf, (size_t)b->off * a->unit, (size_t)off * a->unit, (size_t)b->n * a->unit);
+    }
+
+    b->off = *b->where = off;
+    top = off + b->n;
+  }
+
+  if (a->buf) gl_delete_buffers(1, &a->buf);
+  a->buf = buf;
+  a->cap = cap;
+  a->top = top;
+}
+
+void
+arena_new(struct arena *dst, int unit, int cap) {
+  *dst = (struct arena){.unit = unit};
+  dst->c_blocks = 16;
+  dst->blocks = malloc(sizeof(struct arena_block) * dst->c_blocks);
+  arena_move(dst, cap, true);
+}
+
+/**
+ * n units, their offset also stored in *where. the buffer may be replaced,
+ * so anything holding a->buf has to check it afterwards
+ */
+int
+arena_alloc(struct arena *a, int n, int *where) {
+  int at = a->n_blocks, off = a->top;
+  for (int i = 0, end = 0; i < a->n_blocks; end = a->blocks[i].off + a->blocks[i].n, i++) {
+    if (a->blocks[i].off - end >= n) {
+      at = i;
+      off = end;
+      break;
+    }
+  }
+
+  if (at == a->n_blocks && a->cap - a->top < n) {
+    arena_move(a, max(a->cap * 2, a->used + n), true);
+    off = a->top;
+  }
+
+  int nblocks = a->n_blocks, cblocks = a->c_blocks;
+  struct arena_block *blocks = a->blocks;
+  resize(blocks);
+  a->blocks = blocks;
+  a->c_blocks = cblocks;
+
+  memmove(&a->blocks[at + 1], &a->blocks[at], sizeof(struct arena_block) * (a->n_blocks - at));
+  a->blocks[at] = (struct arena_block){off, n, where};
+  a->n_blocks++;
+  a->used += n;
+  a->top = max(a->top, off + n);
+  return *where = off;
+}
+
+/**
+ * releases the block whose owner is where
+ */
+void
+arena_free(struct arena *a, int *where) {
+  for (int i = 0; i < a->n_blocks; i++) {
+    if (a->blocks[i].where != where) continue;
+
+    a->used -= a->blocks[i].n;
+    memmove(&a->blocks[i], &a->blocks[i + 1], sizeof(struct arena_block) * (a->n_blocks - i - 1));
+    a->n_blocks--;
+    break;
+  }
+
+  a->top = a->n_blocks ? a->blocks[a->n_blocks - 1].off + a->blocks[a->n_blocks - 1].n : 0;
+  if (a->top - a->used > a->top / 2) arena_move(a, a->cap, true);
+}
+
+/**
+ * the arenas every mesh with the same vertex and index size shares, behind
+ * one vertex array, so a program draws them all with one indirect call
+ */
+struct mesh_pool {
+  int va, vt_size, ind_size;
+  struct arena verts, inds;
+};
+
+struct mesh_pool g_pools[4];
+int g_n_pools;
+
+/**
+ * rebinds the arenas' buffers after either was replaced
+ */
+static void
+mesh_pool_bind(struct mesh_pool *p) {
+  gl_vertex_array_vertex_buffer(p->va, 0, p->verts.buf, 0, p->vt_size);
+  gl_vertex_array_element_buffer(p->va, p->inds.buf);
+}
+
+struct mesh_pool *
+mesh_pool_get(int vt_size, int ind_size) {
+  for (int i = 0; i < g_n_pools; i++) {
+    if (g_pools[i].vt_size == vt_size && g_pools[i].ind_size == ind_size) return &g_pools[i];
+  }
+
+  if (g_n_pools == sizeof(g_pools) / sizeof(*g_pools)) {
+    err("too many vertex layouts");
+  }
+
+  struct mesh_pool *p = &g_pools[g_n_pools++];
+  *p = (struct mesh_pool){.vt_size = vt_size, .ind_size = ind_size};
+
+  enum attr const quant[] = {attr_3us_n, attr_1010102_n}, full[] = {attr_3f, attr_3f};
+  gl_create_vertex_arrays(1, &p->va);
+  vertex_array_attrs(p->va, 2, vt_size == sizeof(struct vtq) ? quant : full);
+
+  arena_new(&p->verts, vt_size, 1 << 16);
+  arena_new(&p->inds, ind_size, 1 << 18);
+  mesh_pool_bind(p);
+  return p;
+}
+
+/*-- rings --*/
+
+enum { ring_frames = 3 };
+
+/**
+ * a persistently mapped buffer split into ring_frames regions, one per
+ * frame in flight. a region is handed out front to back during its frame
+ * and fenced at the end of it, and ring_begin waits on that fence before
+ * handing it out again.
+ *
+ * an allocation that doesn't fit replaces the buffer with one twice the
+ * size. the old one stays mapped until the frames that used it are done,
+ * so pointers and offsets already handed out stay good
+ */
+struct ring {
+  int buf;
+  uint8_t *ptr;
+  size_t size, head, end, align;
+  int frame;
+  GLsync fences[ring_frames];
+  struct { int buf, frames; } retired[8];
+  int n_retired;
+
+  size_t streamed;
+  int waits;
+  double wait_ms;
+};
+
+struct ring g_ring;
+
+static void
+ring_map(struct ring *r, size_t size) {
+  int const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  r->size = size;
+  gl_create_buffers(1, &r->buf);
+  gl_named_buffer_storage(r->buf, size, NULL, flags);
+  r->ptr = gl_map_named_buffer_range(r->buf, 0, size, flags);
+  if (!r->ptr) err("failed to map a %zu byte ring", size);
+}
+
+static size_t
+ring_region(struct ring const *r) {
+  return r->size / ring_frames / r->align * r->align;
+}
+
+void
+ring_new(struct ring *dst, size_t size) {
+  int align;
+  gl_get_integerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+
+  *dst = (struct ring){.align = max(align, 16)};
+  ring_map(dst, size);
+  dst->end = ring_region(dst);
+}
+
+/**
+ * starts the next frame's region, waiting for the GPU if it still reads
+ * it from ring_frames frames ago
+ */
+void
+ring_begin(struct ring *r) {
+  r->frame = (r->frame + 1) % ring_frames;
+
+  GLsync f = r->fences[r->frame];
+  if (f) {
+    if (gl_client_wait_sync(f, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      double t0 = sys_time();
+      gl_client_wait_sync(f, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+      r->wait_ms += (sys_time() - t0) * 1e3;
+      r->waits++;
+    }
+
+    gl_delete_sync(f);
+    r->fences[r->frame] = NULL;
+  }
+
+  for (int i = 0; i < r->n_retired; i++) {
+    if (--r->retired[i].frames > 0) continue;
+    gl_delete_buffers(1, &r->retired[i].buf);
+    r->retired[i--] = r->retired[--r->n_retired];
+  }
+
+  r->head = ring_region(r) * r->frame;
+  r->end = r->head + ring_region(r);
+}
+
+/**
+ * fences everything drawn from this frame's region
+ */
+void
+ring_end(struct ring *r) {
+  r->fences[r->frame] = gl_fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * n bytes at a multiple of align, which has to be a power of two. returns
+ * where to write them; buf and off are where draws find them
+ */
+void *
+ring_alloc(struct ring *r, size_t n, size_t align, int *buf, size_t *off) {
+  size_t at = (r->head + align - 1) & ~(align - 1);
+  if (at + n > r->end) {
+    if (r->n_retired == sizeof(r->retired) / sizeof(*r->retired)) {
+      err("ring grew too often in %d frames", ring_frames);
+    }
+
+    r->retired[r->n_retired++] = (typeof(*r->retired)){r->buf, ring_frames};
+    for (int i = 0; i < ring_frames; i++) {
+      if (r->fences[i]) gl_delete_sync(r->fences[i]);
+      r->fences[i] = NULL;
+    }
+
+    size_t size = r->size * 2;
+    while (size / ring_frames < n * 2) size *= 2;
+    ring_map(r, size);
+
+    r->head = ring_region(r) * r->frame;
+    r->end = r->head + ring_region(r);
+    at = (r->head + align - 1) & ~(align - 1);
+  }
+
+  r->head = at + n;
+  r->streamed += n;
+  *buf = r->buf;
+  *off = at;
+  return r->ptr + at;
+}
+
+/*-- meshes --*/
+
+/**
+ * indexed meshes live in a pool at base_vertex and first_index. streamed
+ * meshes have no indices and their own g, and draw the first n_verts of
+ * g.vb, which grows as the upload progresses
+ */
+struct mesh {
+  struct mesh_gpu g;
+  struct mesh_pool *pool;
+  int base_vertex, first_index;
+  struct obj_mesh cpu;
+  struct geom_clusters cl;
+  int64_t n_verts;
+  bool ready;
+};
+
+/**
+ * creates the gpu side of a mesh whose cpu side is loaded. GL thread only
+ */
+void
+mesh_upload(struct mesh *dst) {
+  prof_begin(zone, "mesh_upload");
+  prof_plot("mesh vertices", dst->cpu.n_data);
+  if (!dst->cpu.n_inds) {
+    mesh_gpu_new(&dst->g, 2, attr_3f, attr_3f);
+    gl_named_buffer_data(dst->g.vb, (size_t)dst->cpu.n_data * dst->cpu.vt_size, dst->cpu.data, GL_STATIC_DRAW);
+    dst->n_verts = dst->cpu.n_data;
+    dst->ready = true;
+    prof_end(zone);
+    return;
+  }
+
+  struct mesh_pool *p = dst->pool = mesh_pool_get(dst->cpu.vt_size, dst->cpu.ind_size);
+  int vb = p->verts.buf, ib = p->inds.buf;
+  arena_alloc(&p->verts, dst->cpu.n_data, &dst->base_vertex);
+  arena_alloc(&p->inds, dst->cpu.n_inds, &dst->first_index);
+  if (vb != p->verts.buf || ib != p->inds.buf) mesh_pool_bind(p);
+
+  gl_named_buffer_sub_data(p->verts.buf, (size_t)dst->base_vertex * p->vt_size,
+                           (size_t)dst->cpu.n_data * p->vt_size, dst->cpu.data);
+  gl_named_buffer_sub_data(p->inds.buf, (size_t)dst->first_index * p->ind_size,
+                           (size_t)dst->cpu.n_inds * p->ind_size, dst->cpu.inds);
+  dst->ready = true;
+  prof_end(zone);
+}
+
+/**
+ * gives the mesh's ranges back to its pool, which may compact the others
+ */
+void
+mesh_free(struct mesh *m) {
+  if (m->pool) {
+    struct mesh_pool *p = m->pool;
+    arena_free(&p->verts, &m->base_vertex);
+    arena_free(&p->inds, &m->first_index);
+    mesh_pool_bind(p);
+  } else if (m->ready) {
+    gl_delete_vertex_arrays(1, &m->g.va);
+    gl_delete_buffers(1, &m->g.vb);
+    gl_delete_buffers(1, &m->g.ib);
+  }
+
+  geom_clusters_free(&m->cl);
+  obj_mesh_free(&m->cpu);
+  *m = (struct mesh){0};
+}
+
+/**
+ * the cpu half of loading, safe off the GL thread
+ */
+void
+mesh_load(struct mesh *dst, char const *file, int flags) {
+  prof_begin(zone, "mesh_load");
+  obj_load(&dst->cpu, file, flags);
+
+  double t0 = sys_time();
+  obj_clusters(&dst->cl, &dst->cpu);
+  printf("%s: %d clusters in %.1f ms\n", file, dst->cl.n, (sys_time() - t0) * 1e3);
+  prof_end(zone);
+}
+
+void
+mesh_from_obj(struct mesh *dst, char const *file, int flags) {
+  prof_begin(zone, "mesh_from_obj");
+  mesh_load(dst, file, flags);
+  mesh_upload(dst);
+  prof_end(zone);
+}
+
+int
+mesh_va(struct mesh const *m) {
+  return m->pool ? m->pool->va : m->g.va;
+}
+
+/**
+ * the coarsest level whose error stays under g_lod_px pixels with the
+ * mesh's bounding sphere d units from the eye at its nearest, or d over
+ * the scale for a scaled copy. g_lod_scale is pixels per unit at
+ * distance 1
+ */
+int
+mesh_lod_at(struct mesh const *m, float d) {
+  if (!g_lod || d <= 0) return 0;
+
+  int lod = 0;
+  for (int i = 1; i < m->cpu.n_lods; i++) {
+    if (m->cpu.lod_err[i] * g_lod_scale / d <= g_lod_px) lod = i;
+  }
+
+  return lod;
+}
+
+int
+mesh_lod(struct mesh const *m) {
+  v3 mid = v3_mul(v3_add(m->cpu.lo, m->cpu.hi), 0.5f);
+  return mesh_lod_at(m, v3_dist(g_eye, mid) - v3_dist(m->cpu.lo, m->cpu.hi) * 0.5f);
+}
+
+/**
+ * per-draw data, u_draws in shaders/frame.glsl; shaders index it with
+ * gl_BaseInstance. float meshes get an identity range so QUANT programs
+ * work with either. ids is where the draw's instance ids start, and base
+ * is the base vertex for programs that pull their own
+ */
+struct draw_rec {
+  v3 qmin;
+  uint32_t ids;
+  v3 qext;
+  int base;
+};
+
+/**
+ * the layout glMultiDrawElementsIndirect reads
+ */
+struct draw_cmd {
+  uint32_t count, n_inst, first;
+  int base_vertex;
+  uint32_t base_inst;
+};
+
+/**
+ * and glMultiDrawArraysIndirect's, written over a draw_cmd for programs
+ * that pull their vertices, which then draw with draw_cmd's stride
+ */
+struct draw_arrays_cmd {
+  uint32_t count, n_inst, first, base_inst;
+};
+
+struct draw_rec
+mesh_rec(struct mesh const *m, uint32_t ids) {
+  bool q = m->cpu.vt_size == sizeof(struct vtq);
+  return (struct draw_rec){
+    .qmin = q ? m->cpu.lo : (v3){0, 0, 0},
+    .ids = ids,
+    .qext = q ? v3_sub(m->cpu.hi, m->cpu.lo) : (v3){1, 1, 1},
+    .base = m->base_vertex,
+  };
+}
+
+/**
+ * appends the indirect commands for a pooled mesh to out, which has room
+ * for max(cl.n, 1), and returns how many. rec is the mesh's draw_rec.
+ * g_tris counts the triangles submitted, and what the first level would
+ * have been
+ */
+int
+mesh_cmds(struct mesh *m, int rec, struct draw_cmd *out) {
+  int lod = mesh_lod(m), beg = m->cpu.lod_off[lod], len = m->cpu.lod_off[lod + 1] - beg;
+  struct draw_cmd whole = {len, 1, m->first_index + beg, m->base_vertex, rec};
+
+  if (!g_cull || !m->cl.n) {
+    out[0] = whole;
+    g_tris[0] += len / 3;
+    g_tris[1] += m->cpu.lod_off[1] / 3;
+    return 1;
+  }
+
+  /* only the frustum test: nothing culls back faces, so cones don't apply */
+  int n = 0, end = -1, vis = 0;
+  int const *tri = m->cl.tri;
+  for (int i = 0; i < m->cl.n; i++) {
+    if (geom_cl_outside(&m->cl, i, g_frustum)) continue;
+
+    if (tri[i] == end) {
+      out[n - 1].count += (tri[i + 1] - tri[i]) * 3;
+    } else {
+      out[n++] = (struct draw_cmd){(tri[i + 1] - tri[i]) * 3, 1, m->first_index + tri[i] * 3, m->base_vertex, rec};
+    }
+
+    vis += tri[i + 1] - tri[i];
+    end = tri[i + 1];
+  }
+
+  /* clusters only cover the first level; coarser ones go all or nothing */
+  g_tris[1] += vis;
+  if (!n) return 0;
+
+  if (lod) {
+    out[0] = whole;
+    g_tris[0] += len / 3;
+    return 1;
+  }
+
+  g_tris[0] += vis;
+  return n;
+}
+
+/**
+ * draws n copies of a streamed or unindexed mesh directly, rec being its
+ * draw_rec
+ */
+void
+mesh_draw(struct mesh *m, int rec, int n) {
+  /* first and count are ints, so past that walk the buffer binding instead */
+  int64_t const batch = INT_MAX / 3 * 3;
+  for (int64_t i = 0; i < m->n_verts; i += batch) {
+    if (i) gl_vertex_array_vertex_buffer(m->g.va, 0, m->g.vb, i * m->cpu.vt_size, m->cpu.vt_size);
+    gl_draw_arrays_instanced_base_instance(GL_TRIANGLES, 0, (int)min(batch, m->n_verts - i), n, rec);
+  }
+
+  if (m->n_verts > batch) gl_vertex_array_vertex_buffer(m->g.va, 0, m->g.vb, 0, m->cpu.vt_size);
+  g_tris[0] += m->n_verts / 3 * n;
+  g_tris[1] += m->n_verts / 3 * n;
+}
+
+/*-- assets --*/
+
+/**
+ * a mesh being parsed on its own thread. obj_load already spreads the
+ * parse over all cores, so the thread is mostly there to keep it off the
+ * GL thread while the window and shaders come up. with obj_stream the
+ * thread runs stream instead and the GL thread uploads as it goes
+ */
+struct asset {
+  struct mesh *dst;
+  char const *file;
+  int flags;
+  thrd_t th;
+  atomic_bool parsed;
+  struct obj_stream *stream;
+};
+
+struct asset g_assets[16];
+int g_n_assets, g_n_ready;
+double g_t0;
+bool g_first_frame = true;
+
+static int
+asset_work(void *arg) {
+  struct asset *a = arg;
+  if (a->stream) return obj_stream_run(a->stream);
+
+  mesh_load(a->dst, a->file, a->flags);
+  atomic_store(&a->parsed, true);
+  return 0;
+}
+
+/**
+ * files over g_stream_budget are streamed whether or not flags asks for it
+ */
+void
+asset_load(struct mesh *dst, char const *file, int flags) {
+  if (g_n_assets == sizeof(g_assets) / sizeof(*g_assets)) {
+    err("too many assets in flight");
+  }
+
+  if (file_size(file) > (int64_t)g_stream_budget) flags |= obj_stream;
+
+  struct asset *a = &g_assets[g_n_assets++];
+  *a = (struct asset){.dst = dst, .file = file, .flags = flags};
+  if (flags & obj_stream) {
+    a->stream = malloc(sizeof(struct obj_stream));
+    obj_stream_init(a->stream, file, flags, g_stream_budget);
+  }
+
+  if (thrd_create(&a->th, asset_work, a) != thrd_success) {
+    err("failed to spawn a loader thread for %s", file);
+  }
+}
+
+static void
+asset_ready(void) {
+  if (++g_n_ready == g_n_assets) {
+    printf("startup: all assets ready after %.1f ms\n", (sys_time() - g_t0) * 1e3);
+  }
+}
+
+/**
+ * the buffer is allocated as soon as the pre-scan knows its size, and the
+ * mesh draws whatever prefix has been uploaded so far
+ */
+static void
+asset_stream(struct asset *a) {
+  struct obj_stream *st = a->stream;
+  struct mesh *m = a->dst;
+  if (!atomic_load(&st->scanned)) return;
+
+  if (!m->ready) {
+    mesh_gpu_new(&m->g, 2, attr_3f, attr_3f);
+    gl_named_buffer_storage(m->g.vb, sizeof(struct vt) * max(st->n_verts, 1), NULL, GL_DYNAMIC_STORAGE_BIT);
+    m->cpu.vt_size = sizeof(struct vt);
+    m->ready = true;
+  }
+
+  int slot;
+  int64_t off, n;
+  struct vt const *v;
+  while ((v = obj_stream_peek(st, &slot, &off, &n))) {
+    gl_named_buffer_sub_data(m->g.vb, sizeof(struct vt) * off, sizeof(struct vt) * n, v);
+    m->n_verts = off + n;
+    obj_stream_release(st, slot);
+    prof_plot("streamed vertices", m->n_verts);
+  }
+
+  if (obj_stream_done(st)) {
+    thrd_join(a->th, NULL);
+    m->cpu.lo = st->lo;
+    m->cpu.hi = st->hi;
+    obj_stream_free(st);
+    free(st);
+    a->stream = NULL;
+    asset_ready();
+  }
+}
+
+/**
+ * uploads every asset that finished parsing since the last call. GL
+ * thread only, once per frame
+ */
+void
+assets_poll(void) {
+  for (int i = 0; i < g_n_assets; i++) {
+    struct asset *a = &g_assets[i];
+    if (a->stream) {
+      asset_stream(a);
+      continue;
+    }
+
+    if (a->dst->ready || !atomic_load(&a->parsed)) continue;
+
+    thrd_join(a->th, NULL);
+    mesh_upload(a->dst);
+    asset_ready();
+  }
+}
+
+/*-- camera --*/
+
+struct camera {
+  v3 front, right, up, world_up, pos;
+  float target_yaw, target_pitch, yaw, pitch;
+  m4 v, p, vp;
+};
+
+void
+camera_tick(struct camera *dst) {
+  prof_begin(zone, "camera_tick");
+  dst->yaw = lerp(dst->yaw, dst->target_yaw, 0.25);
+  dst->pitch = lerp(dst->pitch, dst->target_pitch, 0.25);
+
+  dst->front = (v3){
+    sin(rad(dst->yaw)) * cos(rad(dst->pitch)),
+    sin(rad(dst->pitch)),
+    cos(rad(dst->yaw)) * cos(rad(dst->pitch)),
+  };
+
+  v3_norm(&dst->front);
+
+  dst->right = v3_cross(dst->world_up, dst->front);
+
+  dst->up = v3_mul(v3_cross(dst->right, dst->front), -1);
+
+  dst->v = m4_look(dst->pos, dst->front, dst->up);
+  dst->p = m4_persp(rad(45.f), (float)g_w / g_h, 0.001, 100.f);
+  dst->vp = m4_mul(dst->v, dst->p);
+  prof_end(zone);
+}
+
+void
+camera_new(struct camera *dst) {
+  dst->world_up = v3_uy;
+  dst->pos = v3_zero;
+  dst->yaw = 0;
+  dst->pitch = 0;
+
+  camera_tick(dst);
+}
+
+void
+camera_move(struct camera *dst) {
+  float f, r, u;
+  f = ((float)(glfw_get_key(g_win, GLFW_KEY_W) == GLFW_PRESS) - (float)(glfw_get_key(g_win, GLFW_KEY_S) == GLFW_PRESS));
+  r = (-(float)(glfw_get_key(g_win, GLFW_KEY_D) == GLFW_PRESS) + (float)(glfw_get_key(g_win, GLFW_KEY_A) == GLFW_PRESS));
+  u = ((float)(glfw_get_key(g_win, GLFW_KEY_SPACE) == GLFW_PRESS) - (float)(glfw_get_key(g_win, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS));
+
+  v3 delta = v3_add(v3_add(v3_mul(dst->front, f), v3_mul(dst->right, r)), v3_mul(dst->world_up, u));
+  if (v3_len(delta) > 0.0001) v3_norm(&delta);
+  delta = v3_mul(delta, 0.05);
+  dst->pos = v3_add(dst->pos, delta);
+}
+
+/*-- camera paths --*/
+
+/**
+ * one camera key per line, "t x y z yaw pitch", with t in seconds and
+ * increasing; # starts a comment. --record writes one per frame at
+ * cam_dt apart, and a hand-written file can space them out as it likes:
+ * replay runs a Catmull-Rom spline through them either way, sampled at
+ * cam_dt, so a recording replays exactly. yaw and pitch are the camera's
+ * targets, which camera_tick eases toward each frame as it does for the
+ * mouse. recordings also start with "start yaw pitch", the camera's eased
+ * angles when recording began, which replay starts from; paths without it
+ * start at their first key's targets. numbers are written with %.9g so
+ * they read back as the same floats
+ */
+#define cam_dt (1.f / 60.f)
+
+struct cam_key {
+  float t;
+  v3 pos;
+  float yaw, pitch;
+};
+
+struct cam_path {
+  int nkeys, ckeys;
+  struct cam_key *keys;
+  bool has_start;
+  float start_yaw, start_pitch;
+
+  FILE *rec;
+  int frame;
+};
+
+struct cam_path g_rec;
+
+void
+cam_path_load(struct cam_path *dst, char const *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) err("failed to open camera path %s", path);
+
+  int nkeys = 0, ckeys = 64;
+  struct cam_key *keys = malloc(sizeof(struct cam_key) * ckeys);
+
+  bool has_start = false;
+  float start[2];
+  char line[256];
+  for (int ln = 1; fgets(line, sizeof(line), fp); ln++) {
+    struct cam_key k;
+    char *c = line + strspn(line, " \t");
+    if (*c == '#' || *c == '\n' || *c == '\r' || !*c) continue;
+    if (strncmp(c, "start", 5) == 0) {
+      if (sscanf(c, "start %f %f", &start[0], &start[1]) != 2) err("%s:%d: expected start yaw pitch", path, ln);
+      has_start = true;
+      continue;
+    }
+
+    if (sscanf(c, "%f %f %f %f %f %f", &k.t, &k.pos.x, &k.pos.y, &k.pos.z, &k.yaw, &k.pitch) != 6) {
+      err("%s:%d: expected t x y z yaw pitch", path, ln);
+    }
+
+    if (nkeys && k.t <= keys[nkeys - 1].t) err("%s:%d: t has to increase", path, ln);
+
+    resize(keys);
+    keys[nkeys++] = k;
+  }
+
+  fclose(fp);
+  if (!nkeys) err("%s has no camera keys", path);
+
+  *dst = (struct cam_path){.nkeys = nkeys, .ckeys = ckeys, .keys = keys, .has_start = has_start};
+  dst->start_yaw = has_start ? start[0] : keys[0].yaw;
+  dst->start_pitch = has_start ? start[1] : keys[0].pitch;
+}
+
+
+float
+cam_path_len(struct cam_path const *p) {
+  return p->keys[p->nkeys - 1].t - p->keys[0].t;
+}
+
+static float
+catmull(float a, float b, float c, float d, float u) {
+  return 0.5f * (2 * b + (c - a) * u + (2 * a - 5 * b + 4 * c - d) * u * u + (3 * b - a - 3 * c + d) * u * u * u);
+}
+
+/**
+ * moves dst to where the path is t seconds in, clamped to its ends
+ */
+void
+cam_path_at(struct cam_path const *p, float t, struct camera *dst) {
+  struct cam_key const *k = p->keys;
+  t += k[0].t;
+
+  int i = 0;
+  while (i + 2 < p->nkeys && k[i + 1].t <= t) i++;
+
+  int a = max(i - 1, 0), c = min(i + 1, p->nkeys - 1), d = min(i + 2, p->nkeys - 1);
+  float u = c == i ? 0 : clamp((t - k[i].t) / (k[c].t - k[i].t), 0.f, 1.f);
+
+  for (int j = 0; j < 3; j++) {
+    dst->pos.v[j] = catmull(k[a].pos.v[j], k[i].pos.v[j], k[c].pos.v[j], k[d].pos.v[j], u);
+  }
+
+  dst->target_yaw = catmull(k[a].yaw, k[i].yaw, k[c].yaw, k[d].yaw, u);
+  dst->target_pitch = catmull(k[a].pitch, k[i].pitch, k[c].pitch, k[d].pitch, u);
+}
+
+/**
+ * puts dst where the path starts, eased angles included
+ */
+void
+cam_path_begin(struct cam_path const *p, struct camera *dst) {
+  cam_path_at(p, 0, dst);
+  dst->yaw = p->start_yaw;
+  dst->pitch = p->start_pitch;
+}
+
+void
+cam_path_record(struct cam_path *dst, char const *path) {
+  if (!(dst->rec = fopen(path, "w"))) err("failed to create %s", path);
+  fprintf(dst->rec, "# t x y z yaw pitch\n");
+}
+
+/**
+ * appends the camera's input for this frame, if recording
+ */
+void
+cam_path_write(struct cam_path *p, struct camera const *c) {
+  if (!p->rec) return;
+
+  if (p->frame == 0) fprintf(p->rec, "start %.9g %.9g\n", c->yaw, c->pitch);
+  fprintf(p->rec, "%.9g %.9g %.9g %.9g %.9g %.9g\n", p->frame++ * cam_dt, c->pos.x, c->pos.y, c->pos.z,
+          c->target_yaw, c->target_pitch);
+}
+
+/*-- frame --*/
+
+enum { frame_binding = 0 };
+
+/**
+ * shaders/frame.glsl in std140: the vec3 takes the float after it into
+ * its 16 bytes, and the block rounds up to a multiple of 16
+ */
+struct frame_ubo {
+  m4 vp;
+  v3 eye;
+  float time;
+  v2 size;
+  float pad[2];
+};
+
+_Static_assert(sizeof(struct frame_ubo) == 96, "frame_ubo has to match frame.glsl");
+
+int g_frame_ubo;
+
+void
+frame_init(void) {
+  gl_create_buffers(1, &g_frame_ubo);
+  gl_named_buffer_storage(g_frame_ubo, sizeof(struct frame_ubo), NULL, GL_DYNAMIC_STORAGE_BIT);
+  gl_bind_buffer_base(GL_UNIFORM_BUFFER, frame_binding, g_frame_ubo);
+}
+
+/**
+ * one upload for everything the programs share, after camera_tick, and
+ * the view state culling and LOD selection read
+ */
+void
+frame_update(struct camera const *c) {
+  geom_frustum(c->vp, g_frustum);
+  g_eye = c->pos;
+  g_lod_scale = c->p.v[1][1] * g_h * 0.5f;
+
+  struct frame_ubo f = {.vp = c->vp, .eye = c->pos, .time = g_t, .size = {g_w, g_h}};
+  gl_named_buffer_sub_data(g_frame_ubo, 0, sizeof(f), &f);
+}
+
+/*-- instances --*/
+
+enum {
+  inst_binding = 2,
+  inst_ids_binding = 3,
+};
+
+/**
+ * instance in shaders/frame.glsl: the rows of a 3x4 affine transform and
+ * a color lit.fsh tints with
+ */
+struct inst {
+  v4 m[3];
+  v4 color;
+};
+
+/**
+ * a run of transforms kept in g_insts. data is the cpu copy culling and
+ * LOD selection read
+ */
+struct inst_set {
+  struct inst *data;
+  int n, off;
+};
+
+struct arena g_insts;
+struct inst_set g_inst_identity;
+
+v3
+inst_point(struct inst const *x, v3 p) {
+  return (v3){
+    x->m[0].x * p.x + x->m[0].y * p.y + x->m[0].z * p.z + x->m[0].w,
+    x->m[1].x * p.x + x->m[1].y * p.y + x->m[1].z * p.z + x->m[1].w,
+    x->m[2].x * p.x + x->m[2].y * p.y + x->m[2].z * p.z + x->m[2].w,
+  };
+}
+
+/**
+ * the most the transform stretches anything, as the longest column
+ */
+float
+inst_scale(struct inst const *x) {
+  float s = 0;
+  for (int j = 0; j < 3; j++) {
+    v3 col = {x->m[0].v[j], x->m[1].v[j], x->m[2].v[j]};
+    s = max(s, v3_len(col));
+  }
+
+  return s;
+}
+
+void
+inst_set_new(struct inst_set *dst, struct inst const *data, int n) {
+  *dst = (struct inst_set){.data = malloc(sizeof(struct inst) * max(n, 1)), .n = n};
+  memcpy(dst->data, data, sizeof(struct inst) * n);
+
+  arena_alloc(&g_insts, n, &dst->off);
+  gl_named_buffer_sub_data(g_insts.buf, (size_t)dst->off * sizeof(struct inst), sizeof(struct inst) * n, data);
+  gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, inst_binding, g_insts.buf);
+}
+
+void
+inst_set_free(struct inst_set *s) {
+  arena_free(&g_insts, &s->off);
+  gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, inst_binding, g_insts.buf);
+  free(s->data);
+  *s = (struct inst_set){0};
+}
+
+/**
+ * the arena and the identity transform every uninstanced draw uses
+ */
+void
+insts_init(void) {
+  arena_new(&g_insts, sizeof(struct inst), 1 << 12);
+  struct inst id = {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}, {1, 1, 1, 1}};
+  inst_set_new(&g_inst_identity, &id, 1);
+}
+
+/*-- render queue --*/
+
+/**
+ * a draw's key, from the high bits down: program, vertex array, depth
+ * bucket front to back, then the index of its payload. sorting the keys
+ * groups draws by state, and the index keeps equal keys in submit order
+ */
+enum {
+  rq_prog_bits = 12,
+  rq_va_bits = 16,
+  rq_depth_bits = 12,
+  rq_index_bits = 24,
+  rq_draws_binding = 1,
+  rq_pull_verts_binding = 4,
+  rq_pull_inds_binding = 5,
+};
+
+/**
+ * an item draws m with n transforms from set starting at first, or once
+ * untransformed without a set. beg and end are its commands, filled in
+ * by the flush
+ */
+struct rq_item {
+  struct shader *s;
+  struct mesh *m;
+  struct inst_set const *set;
+  int first, n;
+  int beg, end;
+};
+
+/**
+ * recs, ids and cmds are rebuilt by every flush and streamed through
+ * g_ring: a draw_rec per command, or per item for cluster runs, the
+ * instance ids each instanced command draws, and the indirect commands
+ * themselves
+ */
+struct rq {
+  uint64_t *keys, *tmp;
+  struct rq_item *items;
+  int n, cap;
+
+  struct draw_rec *recs;
+  uint32_t *ids;
+  struct draw_cmd *cmds;
+  int n_recs, c_recs, n_ids, c_ids, n_cmds, c_cmds;
+  int pull_va;
+};
+
+struct rq g_rq;
+
+void
+rq_init(struct rq *q) {
+  *q = (struct rq){0};
+  gl_create_vertex_arrays(1, &q->pull_va);
+}
+
+/**
+ * room for n more of a in q, for the grow-as-you-go arrays above
+ */
+#define rq_reserve(q, a, n) do { \
+  if ((q)->n_##a + (n) > (q)->c_##a) { \
+    (q)->c_##a = max((q)->n_##a + (n), (q)->c_##a * 2); \
+    (q)->a = realloc((q)->a, sizeof(*(q)->a) * (q)->c_##a); \
+  } \
+} while (false)
+
+/**
+ * n copies of m with set's transforms from first, or one untransformed
+ * if set is NULL. depth is the distance to the first copy's bounds center
+ * over the far plane
+ */
+void
+rq_push_inst(struct rq *q, struct shader *s, struct mesh *m, struct inst_set const *set, int first, int n) {
+  if (!m->ready || !n || q->n == 1 << rq_index_bits) return;
+  if (s->per_tri && !m->pool) s = s->fallback;
+
+  if (q->n == q->cap) {
+    q->cap = max(q->cap * 2, 256);
+    q->keys = realloc(q->keys, sizeof(uint64_t) * q->cap);
+    q->tmp = realloc(q->tmp, sizeof(uint64_t) * q->cap);
+    q->items = realloc(q->items, sizeof(struct rq_item) * q->cap);
+  }
+
+  v3 mid = v3_mul(v3_add(m->cpu.lo, m->cpu.hi), 0.5f);
+  if (set) mid = inst_point(&set->data[first], mid);
+  float d = min(v3_dist(g_eye, mid) / 100.f, 1.f);
+
+  uint64_t prog = (uint64_t)s->id & ((1 << rq_prog_bits) - 1);
+  uint64_t va = (uint64_t)mesh_va(m) & ((1 << rq_va_bits) - 1);
+  uint64_t depth = (uint64_t)(d * ((1 << rq_depth_bits) - 1));
+
+  q->items[q->n] = (struct rq_item){s, m, set, first, n};
+  q->keys[q->n] = prog << (rq_va_bits + rq_depth_bits + rq_index_bits)
+                  | va << (rq_depth_bits + rq_index_bits)
+                  | depth << rq_index_bits
+                  | (uint64_t)q->n;
+  q->n++;
+}
+
+void
+rq_push(struct rq *q, struct shader *s, struct mesh *m) {
+  rq_push_inst(q, s, m, NULL, 0, 1);
+}
+
+/**
+ * LSD radix sort a byte at a time over the bits above the index, which is
+ * already in order. bytes every key shares are skipped
+ */
+static void
+rq_sort(struct rq *q) {
+  for (int shift = rq_index_bits; shift < 64; shift += 8) {
+    int cnt[257] = {0};
+    for (int i = 0; i < q->n; i++) cnt[(q->keys[i] >> shift & 255) + 1]++;
+    if (cnt[(q->keys[0] >> shift & 255) + 1] == q->n) continue;
+
+    for (int i = 1; i < 257; i++) cnt[i] += cnt[i - 1];
+    for (int i = 0; i < q->n; i++) q->tmp[cnt[q->keys[i] >> shift & 255]++] = q->keys[i];
+
+    uint64_t *t = q->keys;
+    q->keys = q->tmp;
+    q->tmp = t;
+  }
+}
+
+static struct rq_item *
+rq_item(struct rq const *q, int i) {
+  return &q->items[q->keys[i] & ((1 << rq_index_bits) - 1)];
+}
+
+/**
+ * culls an instanced item's copies against the frustum and buckets the
+ * rest by level, one command and record per non-empty level. the
+ * object-space clusters don't apply to transformed copies
+ */
+static void
+rq_item_insts(struct rq *q, struct rq_item *it) {
+  struct mesh *m = it->m;
+  v3 mid = v3_mul(v3_add(m->cpu.lo, m->cpu.hi), 0.5f);
+  float r = v3_dist(m->cpu.lo, m->cpu.hi) * 0.5f;
+
+  int cnt[geom_max_lods + 1] = {0};
+  uint8_t small[64];
+  uint8_t *lods = it->n <= 64 ? small : malloc(it->n);
+  for (int i = 0; i < it->n; i++) {
+    struct inst const *x = &it->set->data[it->first + i];
+    float s = inst_scale(x);
+    v3 c = inst_point(x, mid);
+
+    lods[i] = geom_sphere_outside(c, r * s, g_frustum)
+              ? geom_max_lods
+              : mesh_lod_at(m, (v3_dist(g_eye, c) - r * s) / max(s, 1e-6f));
+    cnt[lods[i]]++;
+  }
+
+  int at[geom_max_lods];
+  rq_reserve(q, ids, it->n);
+  rq_reserve(q, recs, geom_max_lods);
+  rq_reserve(q, cmds, geom_max_lods);
+
+  for (int l = 0, n = q->n_ids; l < geom_max_lods; l++) {
+    at[l] = n;
+    n += cnt[l];
+    g_tris[1] += (int64_t)cnt[l] * (m->cpu.lod_off[1] / 3);
+    if (!cnt[l]) continue;
+
+    int beg = m->cpu.lod_off[l], len = m->cpu.lod_off[l + 1] - beg;
+    q->cmds[q->n_cmds++] = (struct draw_cmd){len, cnt[l], m->first_index + beg, m->base_vertex, q->n_recs};
+    q->recs[q->n_recs++] = mesh_rec(m, at[l]);
+    g_tris[0] += (int64_t)cnt[l] * (len / 3);
+  }
+
+  for (int i = 0; i < it->n; i++) {
+    if (lods[i] < geom_max_lods) q->ids[at[lods[i]]++] = it->set->off + it->first + i;
+  }
+
+  q->n_ids += it->n - cnt[geom_max_lods];
+  if (lods != small) free(lods);
+}
+
+/**
+ * copies n bytes into g_ring and binds them to the storage buffer binding,
+ * or as the indirect buffer for -1. returns their offset
+ */
+static size_t
+rq_stream(struct rq *q, int binding, void const *data, size_t n) {
+  int buf;
+  size_t off;
+  if (!n) return 0;
+
+  memcpy(ring_alloc(&g_ring, n, g_ring.align, &buf, &off), data, n);
+  if (binding < 0) {
+    gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, buf);
+  } else {
+    gl_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, binding, buf, off, n);
+  }
+
+  return off;
+}
+
+/**
+ * sorts everything pushed since the last flush and draws it: one
+ * glMultiDrawElementsIndirect per run of pooled meshes with the same
+ * program and pool, a direct draw for the rest. programs and vertex
+ * arrays only change where the key does
+ */
+void
+rq_flush(struct rq *q) {
+  if (!q->n) return;
+
+  rq_sort(q);
+
+  /* commands go in sorted order, so a run's commands are contiguous too */
+  q->n_recs = q->n_cmds = q->n_ids = 0;
+  rq_reserve(q, ids, 1);
+  q->ids[q->n_ids++] = g_inst_identity.off;
+
+  for (int i = 0; i < q->n; i++) {
+    struct rq_item *it = rq_item(q, i);
+    struct mesh *m = it->m;
+    it->beg = q->n_cmds;
+
+    if (it->set && m->pool) {
+      rq_item_insts(q, it);
+    } else if (it->set) {
+      rq_reserve(q, ids, it->n);
+      rq_reserve(q, recs, 1);
+      q->recs[q->n_recs++] = mesh_rec(m, q->n_ids);
+      for (int j = 0; j < it->n; j++) q->ids[q->n_ids++] = it->set->off + it->first + j;
+    } else {
+      rq_reserve(q, recs, 1);
+      rq_reserve(q, cmds, max(m->cl.n, 1));
+      q->recs[q->n_recs] = mesh_rec(m, 0);
+      if (m->pool) q->n_cmds += mesh_cmds(m, q->n_recs, &q->cmds[q->n_cmds]);
+      q->n_recs++;
+    }
+
+    /* direct draws have no commands, so end holds their record */
+    it->end = m->pool ? q->n_cmds : q->n_recs - 1;
+
+    /*
+     * pulled shaders find their triangle and corner from gl_VertexID, so a
+     * command has to start and end on a triangle. index arena blocks and
+     * lod levels are whole triangles, which keeps that true; this catches
+     * whatever breaks it before it draws garbage
+     */
+    for (int c = it->beg; it->s->per_tri && c < it->end; c++) {
+      struct draw_cmd e = q->cmds[c];
+      if (e.first % 3 || e.count % 3) {
+        err("pulled draw of %u indices from %u is not whole triangles", e.count, e.first);
+      }
+
+      struct draw_arrays_cmd a = {e.count / 3 * it->s->per_tri, e.n_inst, e.first / 3 * it->s->per_tri, e.base_inst};
+      memcpy(&q->cmds[c], &a, sizeof(a));
+    }
+  }
+
+  rq_stream(q, rq_draws_binding, q->recs, sizeof(struct draw_rec) * q->n_recs);
+  rq_stream(q, inst_ids_binding, q->ids, sizeof(uint32_t) * q->n_ids);
+  size_t cmd_off = rq_stream(q, -1, q->cmds, sizeof(struct draw_cmd) * q->n_cmds);
+  g_rq_stats.cmds += q->n_cmds;
+
+  struct shader *cur = NULL;
+  for (int i = 0; i < q->n;) {
+    struct rq_item *it = rq_item(q, i);
+    if (it->s != cur) {
+      shader_use(it->s);
+      cur = it->s;
+      g_rq_stats.programs++;
+    }
 
-void
-shader_set_m4f(struct shader *dst, char const *name, m4 *m) {
-  for (int i = 0; i < dst->n_unis; i++) {
-    if (strcmp(dst->unis[i].name, name) == 0) {
-      gl_program_uniform_matrix_4fv(dst->id, dst->unis[i].loc, 1, GL_TRUE, &m->_00);
-      break;
+    int va = it->s->per_tri ? q->pull_va : mesh_va(it->m);
+    if (g_va != va) {
+      gl_bind_vertex_array(va);
+      g_va = va;
+      g_rq_stats.vaos++;
     }
-  }
-}
 
-void
-shader_set_1f(struct shader *dst, char const *name, float v) {
-  for (int i = 0; i < dst->n_unis; i++) {
-    if (strcmp(dst->unis[i].name, name) == 0) {
-      gl_program_uniform_1f(dst->id, dst->unis[i].loc, v);
-      break;
+    if (!it->m->pool) {
+      mesh_draw(it->m, it->end, it->n);
+      g_rq_stats.draws++;
+      i++;
+      continue;
     }
-  }
-}
 
-void
-shader_set_3f(struct shader *dst, char const *name, v3 v) {
-  for (int i = 0; i < dst->n_unis; i++) {
-    if (strcmp(dst->unis[i].name, name) == 0) {
-      gl_program_uniform_3f(dst->id, dst->unis[i].loc, v.x, v.y, v.z);
-      break;
+    struct mesh_pool *p = it->m->pool;
+    int beg = it->beg, end = it->end;
+    for (i++; i < q->n && rq_item(q, i)->s == cur && rq_item(q, i)->m->pool == p; i++) {
+      end = rq_item(q, i)->end;
     }
-  }
-}
 
-void
-shader_set_2f(struct shader *dst, char const *name, v2 v) {
-  for (int i = 0; i < dst->n_unis; i++) {
-    if (strcmp(dst->unis[i].name, name) == 0) {
-      gl_program_uniform_2f(dst->id, dst->unis[i].loc, v.x, v.y);
-      break;
+    if (end == beg) continue;
+
+    void const *at = (void const *)(cmd_off + sizeof(struct draw_cmd) * beg);
+    if (cur->per_tri) {
+      gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, rq_pull_verts_binding, p->verts.buf);
+      gl_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, rq_pull_inds_binding, p->inds.buf);
+      shader_put_1i(cur, cur->fmt, (p->ind_size == 2) | (p->vt_size == sizeof(struct vtq)) << 1);
+      gl_multi_draw_arrays_indirect(cur->prim, at, end - beg, sizeof(struct draw_cmd));
+    } else {
+      int type = p->ind_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+      gl_multi_draw_elements_indirect(GL_TRIANGLES, type, at, end - beg, 0);
     }
+
+    g_rq_stats.draws++;
   }
-}
 
-/*-- meshes --*/
+  q->n = 0;
+}
 
-enum attr {
-  attr_1f,
-  attr_2f,
-  attr_3f,
-  attr_4f
-};
+/*-- stress scene --*/
 
-struct mesh_gpu {
-  int va, vb, ib;
-};
+struct inst_set g_stress;
+bool g_stress_inst = true;
 
+/**
+ * n copies of the tree scattered over a disc around the origin with
+ * random yaw, scale and tint
+ */
 void
-mesh_gpu_new(struct mesh_gpu *dst, int n, ...) {
-  gl_create_vertex_arrays(1, &dst->va);
-  gl_create_buffers(1, &dst->vb);
-  gl_create_buffers(1, &dst->ib);
-
-  enum attr attrs[n];
+stress_new(int n) {
+  struct inst *xs = malloc(sizeof(struct inst) * n);
+  float extent = sqrtf((float)n) * 1.5f;
+  srand(1);
 
-  int stride = 0;
-  va_list va;
-  va_start(va, n);
   for (int i = 0; i < n; i++) {
-    attrs[i] = va_arg(va, enum attr);
-    stride += (attrs[i] + 1) * sizeof(float);
+    float a = (float)rand() / RAND_MAX * rad(360), d = sqrtf((float)rand() / RAND_MAX) * extent;
+    float yaw = (float)rand() / RAND_MAX * rad(360), s = 0.5f + (float)rand() / RAND_MAX;
+    float c = cosf(yaw) * s, sn = sinf(yaw) * s;
+    xs[i] = (struct inst){
+      {{c, 0, sn, cosf(a) * d}, {0, s, 0, -2}, {-sn, 0, c, sinf(a) * d}},
+      {0.5f + (float)rand() / RAND_MAX * 0.5f, 0.5f + (float)rand() / RAND_MAX * 0.5f, 0.5f, 1},
+    };
   }
 
-  va_end(va);
+  inst_set_new(&g_stress, xs, n);
+  free(xs);
+  printf("stress: %d trees, I switches between one item and one per copy\n", n);
+}
 
-  gl_vertex_array_vertex_buffer(dst->va, 0, dst->vb, 0, stride);
-  gl_vertex_array_element_buffer(dst->va, dst->ib);
+/**
+ * the whole set as one instanced item, or one item per copy for the path
+ * instancing replaces
+ */
+void
+stress_push(struct shader *s) {
+  if (!g_stress.n) return;
 
-  unsigned off = 0;
-  for (int i = 0; i < n; i++) {
-    gl_enable_vertex_array_attrib(dst->va, i);
-    gl_vertex_array_attrib_format(dst->va, i, attrs[i] + 1, GL_FLOAT, GL_FALSE, off);
-    gl_vertex_array_attrib_binding(dst->va, i, 0);
-    off += (attrs[i] + 1) * sizeof(float);
+  if (g_stress_inst) {
+    rq_push_inst(&g_rq, s, &tree, &g_stress, 0, g_stress.n);
+  } else {
+    for (int i = 0; i < g_stress.n; i++) rq_push_inst(&g_rq, s, &tree, &g_stress, i, 1);
   }
 }
 
-struct mesh {
-  struct mesh_gpu g;
-  int n_data, n_inds;
-  void *data;
-  int *inds;
+/*-- hud --*/
+
+enum {
+  hud_binding = 6,
+  hud_window = 256,
+  hud_first = 32,
+  hud_n_chars = 96,
+  hud_atlas = 512,
 };
 
-struct vt {
-  v3 p, n;
+/**
+ * a corner of each glyph in pixels from the window's top left and where
+ * it is in the atlas, as text.vsh reads them
+ */
+struct glyph {
+  float x0, y0, x1, y1;
+  float s0, t0, s1, t1;
 };
 
 /**
- * precondition: dst.g is already populated
+ * frame stats, drawn over the frame and optionally appended to a csv one
+ * row per frame. ms is a rolling window of cpu frame times; draws and
+ * tris are the last frame's for each mode, so switching modes with N
+ * fills in the table.
+ *
+ * the csv goes through a 1 MB stdio buffer, flushed only when it fills,
+ * so a row costs a formatted copy rather than a write
  */
-void
-mesh_from_obj(struct mesh *dst, char const *file, bool t) {
-  int np = 0, cp = 4;
-  v3 *p = malloc(sizeof(v3) * cp);
+struct hud {
+  bool on;
+  struct shader s;
+  int tex;
+  float px;
+  stbtt_bakedchar chars[hud_n_chars];
+
+  int nglyphs, cglyphs;
+  struct glyph *glyphs;
+
+  float ms[hud_window];
+  int n_ms, frame;
+  int64_t draws[5], tris[5];
+  bool seen[5];
+
+  FILE *csv;
+  char *csv_buf;
+};
 
-  int nn = 0, cn = 4;
-  v3 *n = malloc(sizeof(v3) * cn);
+struct hud g_hud = {.on = true};
 
-  int nv = 0, cv = 4;
-  struct vt *v = malloc(sizeof(struct vt) * cv);
+/**
+ * bakes the font at a size that reads on the window it starts with
+ */
+void
+hud_init(char const *defs) {
+  FILE *f = fopen("./res/futura/futura-reg.TTF", "rb");
+  if (!f) err("failed to open the hud font");
+
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *ttf = malloc(len);
+  if (fread(ttf, 1, len, f) != (size_t)len) err("failed to read the hud font");
+  fclose(f);
+
+  uint8_t *px = malloc(hud_atlas * hud_atlas);
+  g_hud.px = max(16, g_h / 64);
+  if (stbtt_BakeFontBitmap(ttf, 0, g_hud.px, px, hud_atlas, hud_atlas, hud_first, hud_n_chars, g_hud.chars) <= 0) {
+    err("hud font doesn't fit a %d atlas at %.0f px", hud_atlas, g_hud.px);
+  }
 
+  gl_create_textures(GL_TEXTURE_2D, 1, &g_hud.tex);
+  gl_texture_storage_2d(g_hud.tex, 1, GL_R8, hud_atlas, hud_atlas);
+  gl_pixel_storei(GL_UNPACK_ALIGNMENT, 1);
+  gl_texture_sub_image_2d(g_hud.tex, 0, 0, 0, hud_atlas, hud_atlas, GL_RED, GL_UNSIGNED_BYTE, px);
+  gl_pixel_storei(GL_UNPACK_ALIGNMENT, 4);
+  gl_texture_parameteri(g_hud.tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  gl_texture_parameteri(g_hud.tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  FILE *fp = fopen(file, "r");
-  char buf[128];
+  free(px);
+  free(ttf);
 
-  while (fgets(buf, sizeof(buf), fp)) {
-    if (buf[0] == 'v') {
-      if (buf[1] == ' ') {
-        resize(p);
-        sscanf(buf, "v %f %f %f", &p[np].x, &p[np].y, &p[np].z);
-        np++;
-      } else if (buf[1] == 'n') {
-        resize(n);
-        sscanf(buf, "vn %f %f %f", &n[nn].x, &n[nn].y, &n[nn].z);
-        v3_norm(&n[nn]);
-        nn++;
-      } else if (buf[1] == 't') {
-        // don't care
-      }
-    } else if (buf[0] == 'f') {
-      int p0, n0, p1, n1, p2, n2;
-      int dummy;
-      if (t) {
-        sscanf(buf, "f %d/%d/%d %d/%d/%d %d/%d/%d", &p0, &dummy, &n0, &p1, &dummy, &n1, &p2, &dummy, &n2);
-      } else {
-        sscanf(buf, "f %d//%d %d//%d %d//%d", &p0, &n0, &p1, &n1, &p2, &n2);
-      }
+  g_hud.cglyphs = 256;
+  g_hud.glyphs = malloc(sizeof(struct glyph) * g_hud.cglyphs);
 
-      p0--, n0--, p1--, n1--, p2--, n2--;
+  shader_new(&g_hud.s, "./shaders/text.vsh", "./shaders/text.fsh", NULL, defs);
+}
 
-      struct vt a, b, c;
-      a.p = p[p0];
-      b.p = p[p1];
-      c.p = p[p2];
+void
+hud_csv(char const *path) {
+  if (!(g_hud.csv = fopen(path, "w"))) err("failed to open %s", path);
 
-      a.n = n[n0];
-      b.n = n[n1];
-      c.n = n[n2];
+  g_hud.csv_buf = malloc(1 << 20);
+  setvbuf(g_hud.csv, g_hud.csv_buf, _IOFBF, 1 << 20);
+  fprintf(g_hud.csv, "frame,mode,pull,cpu_ms,draws,commands,triangles\n");
+}
 
-      resize(v);
-      v[nv++] = a;
+void
+hud_close(void) {
+  if (!g_hud.csv) return;
 
-      resize(v);
-      v[nv++] = b;
+  fclose(g_hud.csv);
+  free(g_hud.csv_buf);
+  g_hud.csv = NULL;
+}
 
-      resize(v);
-      v[nv++] = c;
-    }
+/**
+ * one frame's numbers: ms of cpu time, and what the render queue drew
+ */
+void
+hud_sample(float ms, int64_t draws, int64_t cmds, int64_t tris) {
+  g_hud.ms[g_hud.frame % hud_window] = ms;
+  g_hud.n_ms = min(g_hud.n_ms + 1, hud_window);
+  g_hud.draws[g_n] = draws;
+  g_hud.tris[g_n] = tris;
+  g_hud.seen[g_n] = true;
+
+  if (g_hud.csv) {
+    fprintf(g_hud.csv, "%d,%s,%d,%.4f,%lld,%lld,%lld\n", g_hud.frame, g_mode_names[g_n], g_pull, ms,
+            (long long)draws, (long long)cmds, (long long)tris);
   }
 
-  fclose(fp);
-
-  dst->n_data = nv;
-  dst->data = v;
-  dst->n_inds = 0;
-  dst->inds = 0;
+  g_hud.frame++;
+}
 
-  gl_named_buffer_data(dst->g.vb, nv * sizeof(struct vt), v, GL_STATIC_DRAW);
-  free(p);
-  free(n);
+static int
+float_cmp(void const *a, void const *b) {
+  float x = *(float const *)a, y = *(float const *)b;
+  return (x > y) - (x < y);
 }
 
-/*-- camera --*/
+/**
+ * lays out a line of text at x, y (the baseline), in pixels from the top left
+ */
+void
+hud_print(float x, float y, char const *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+
+  int nglyphs = g_hud.nglyphs, cglyphs = g_hud.cglyphs;
+  struct glyph *glyphs = g_hud.glyphs;
+  for (char const *s = buf; *s; s++) {
+    /* unsigned, so bytes past ascii land above the baked range rather than below it */
+    int c = (unsigned char)*s;
+    if (c < hud_first || c >= hud_first + hud_n_chars) continue;
+
+    stbtt_aligned_quad q;
+    stbtt_GetBakedQuad(g_hud.chars, hud_atlas, hud_atlas, c - hud_first, &x, &y, &q, 1);
+    resize(glyphs);
+    glyphs[nglyphs++] = (struct glyph){q.x0, q.y0, q.x1, q.y1, q.s0, q.t0, q.s1, q.t1};
+  }
 
-struct camera {
-  v3 front, right, up, world_up, pos;
-  float target_yaw, target_pitch, yaw, pitch;
-  m4 v, p, vp;
-};
+  g_hud.nglyphs = nglyphs;
+  g_hud.cglyphs = cglyphs;
+  g_hud.glyphs = glyphs;
+}
 
+/**
+ * everything printed this frame in one draw, glyphs streamed through
+ * g_ring like the render queue's records
+ */
 void
-camera_tick(struct camera *dst) {
-  dst->yaw = lerp(dst->yaw, dst->target_yaw, 0.25);
-  dst->pitch = lerp(dst->pitch, dst->target_pitch, 0.25);
-
-  dst->front = (v3){
-    sin(rad(dst->yaw)) * cos(rad(dst->pitch)),
-    sin(rad(dst->pitch)),
-    cos(rad(dst->yaw)) * cos(rad(dst->pitch)),
-  };
+hud_draw(void) {
+  if (!g_hud.on || !g_hud.n_ms) return;
+
+  float sorted[hud_window];
+  int n = g_hud.n_ms;
+  memcpy(sorted, g_hud.ms, sizeof(float) * n);
+  qsort(sorted, n, sizeof(float), float_cmp);
+
+  float lh = g_hud.px * 1.2f, x = g_hud.px, y = lh;
+  float last = g_hud.ms[(g_hud.frame - 1) % hud_window];
+  hud_print(x, y, "cpu %.2f ms   p50 %.2f   p95 %.2f   p99 %.2f   (%d frames)", last,
+            sorted[n / 2], sorted[(n - 1) * 95 / 100], sorted[(n - 1) * 99 / 100], n);
+
+  for (int i = 0; i < 5; i++) {
+    if (!g_hud.seen[i]) continue;
+    y += lh;
+    hud_print(x, y, "%s %s%s: %lld draws, %lld triangles", i == g_n ? ">" : " ", g_mode_names[i],
+              i == g_n && g_pull ? " (pull)" : "", (long long)g_hud.draws[i], (long long)g_hud.tris[i]);
+  }
 
-  v3_norm(&dst->front);
+  int buf;
+  size_t off, len = sizeof(struct glyph) * g_hud.nglyphs;
+  memcpy(ring_alloc(&g_ring, len, g_ring.align, &buf, &off), g_hud.glyphs, len);
+  gl_bind_buffer_range(GL_SHADER_STORAGE_BUFFER, hud_binding, buf, off, len);
 
-  dst->right = v3_cross(dst->world_up, dst->front);
+  shader_use(&g_hud.s);
+  if (g_va != g_rq.pull_va) {
+    gl_bind_vertex_array(g_rq.pull_va);
+    g_va = g_rq.pull_va;
+  }
 
-  dst->up = v3_mul(v3_cross(dst->right, dst->front), -1);
+  gl_bind_texture_unit(0, g_hud.tex);
+  gl_disable(GL_DEPTH_TEST);
+  gl_enable(GL_BLEND);
+  gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gl_draw_arrays(GL_TRIANGLES, 0, g_hud.nglyphs * 6);
+  gl_disable(GL_BLEND);
+  gl_enable(GL_DEPTH_TEST);
 
-  dst->v = m4_look(dst->pos, dst->front, dst->up);
-  dst->p = m4_persp(rad(45.f), (float)g_w / g_h, 0.001, 100.f);
-  dst->vp = m4_mul(dst->v, dst->p);
+  g_hud.nglyphs = 0;
 }
 
-void
-camera_new(struct camera *dst) {
-  dst->world_up = v3_uy;
-  dst->pos = v3_zero;
-  dst->yaw = 0;
-  dst->pitch = 0;
-
-  camera_tick(dst);
-}
+/*-- frame loop --*/
 
+/**
+ * everything a frame draws from camera's current state, started at
+ * t_frame
+ */
 void
-camera_move(struct camera *dst) {
-  float f, r, u;
-  f = ((float)(glfw_get_key(g_win, GLFW_KEY_W) == GLFW_PRESS) - (float)(glfw_get_key(g_win, GLFW_KEY_S) == GLFW_PRESS));
-  r = (-(float)(glfw_get_key(g_win, GLFW_KEY_D) == GLFW_PRESS) + (float)(glfw_get_key(g_win, GLFW_KEY_A) == GLFW_PRESS));
-  u = ((float)(glfw_get_key(g_win, GLFW_KEY_SPACE) == GLFW_PRESS) - (float)(glfw_get_key(g_win, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS));
-
-  v3 delta = v3_add(v3_add(v3_mul(dst->front, f), v3_mul(dst->right, r)), v3_mul(dst->world_up, u));
-  if (v3_len(delta) > 0.0001) v3_norm(&delta);
-  delta = v3_mul(delta, 0.05);
-  dst->pos = v3_add(dst->pos, delta);
+frame_draw(double t_frame) {
+  gl_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  ring_begin(&g_ring);
+  frame_update(&camera);
+
+  assets_poll();
+  shaders_poll();
+
+  prof_begin(draw, "draw");
+  prof_name(draw, g_mode_names[g_n]);
+  int64_t tris = g_tris[0], draws = g_rq_stats.draws, cmds = g_rq_stats.cmds;
+  struct shader *mode = g_modes[g_pull][g_n];
+  rq_push(&g_rq, mode, &mesh);
+  rq_push(&g_rq, mode, &tree);
+  stress_push(mode);
+  rq_flush(&g_rq);
+  prof_plot("triangles submitted", g_tris[0] - tris);
+  prof_end(draw);
+
+  hud_draw();
+  ring_end(&g_ring);
+  hud_sample((sys_time() - t_frame) * 1e3, g_rq_stats.draws - draws, g_rq_stats.cmds - cmds, g_tris[0] - tris);
 }
 
 /*-- callbacks --*/
@@ -355,6 +2184,23 @@ key_cb(GLFWwindow *win, int key, int scan, int act, int mods) {
     g_n %= 5;
   }
 
+  if (act == GLFW_PRESS && key == GLFW_KEY_P) {
+    g_pull = !g_pull;
+  }
+
+  if (act == GLFW_PRESS && key == GLFW_KEY_I) {
+    g_stress_inst = !g_stress_inst;
+  }
+
+  if (act == GLFW_PRESS && key == GLFW_KEY_H) {
+    g_hud.on = !g_hud.on;
+  }
+
+  if (act == GLFW_PRESS && key == GLFW_KEY_L) {
+    g_lod = !g_lod;
+    printf("lod %s\n", g_lod ? "on" : "off");
+  }
+
 }
 
 void
@@ -364,10 +2210,340 @@ fb_size_cb(GLFWwindow *win, int w, int h) {
   g_h = h;
 }
 
+/*-- headless --*/
+
+/**
+ * headless builds have no window: frames go into fbo, multisampled like
+ * the window's, and are resolved into res to be read back. the context is
+ * a surfaceless EGL one, which Mesa's llvmpipe provides without a display
+ */
+struct headless {
+  int frames;
+  char const *out;
+  int fbo, color, depth;
+  int res, res_color;
+#ifdef HEADLESS
+  EGLDisplay dpy;
+  EGLContext ctx;
+#endif
+};
+
+struct headless g_hl = {.frames = 60, .out = "./headless.png"};
+
+/**
+ * --size WxH, --frames n, --mode n, --out file.png, and --hud to draw the
+ * hud into the image, which it leaves out otherwise
+ */
+void
+headless_args(int argc, char **argv) {
+  g_hud.on = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--hud") == 0) g_hud.on = true;
+  }
+
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--size") == 0) {
+      sscanf(argv[++i], "%dx%d", &g_w, &g_h);
+    } else if (strcmp(argv[i], "--frames") == 0) {
+      g_hl.frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--mode") == 0) {
+      g_n = atoi(argv[++i]) % 5;
+    } else if (strcmp(argv[i], "--out") == 0) {
+      g_hl.out = argv[++i];
+    }
+  }
+}
+
+#ifdef HEADLESS
+/**
+ * llvmpipe only reports 4.5 but has everything the shaders use, so Mesa
+ * is told to offer 4.6 unless the environment says otherwise
+ */
+void
+headless_init(void) {
+  setenv("MESA_GL_VERSION_OVERRIDE", "4.6", 0);
+  setenv("MESA_GLSL_VERSION_OVERRIDE", "460", 0);
+
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  g_hl.dpy = get_display ? get_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+  if (g_hl.dpy == EGL_NO_DISPLAY) g_hl.dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  int major, minor;
+  if (!eglInitialize(g_hl.dpy, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+    err("failed to init EGL: 0x%x", eglGetError());
+  }
+
+  int const cfg_attrs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  int const ctx_attrs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 4,
+    EGL_CONTEXT_MINOR_VERSION, 6,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE,
+  };
+
+  EGLConfig cfg = NULL;
+  int n_cfgs = 0;
+  eglChooseConfig(g_hl.dpy, cfg_attrs, &cfg, 1, &n_cfgs);
+  g_hl.ctx = eglCreateContext(g_hl.dpy, n_cfgs ? cfg : NULL, EGL_NO_CONTEXT, ctx_attrs);
+  if (g_hl.ctx == EGL_NO_CONTEXT || !eglMakeCurrent(g_hl.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, g_hl.ctx)) {
+    err("failed to create a GL 4.6 context through EGL: 0x%x", eglGetError());
+  }
+
+  g_get_proc = (GLADloadproc)eglGetProcAddress;
+  if (!glad_load_gl_loader(g_get_proc)) {
+    err("failed to load glad!");
+  }
+
+  gl_create_renderbuffers(1, &g_hl.color);
+  gl_create_renderbuffers(1, &g_hl.depth);
+  gl_named_renderbuffer_storage_multisample(g_hl.color, 4, GL_RGBA8, g_w, g_h);
+  gl_named_renderbuffer_storage_multisample(g_hl.depth, 4, GL_DEPTH_COMPONENT24, g_w, g_h);
+  gl_create_framebuffers(1, &g_hl.fbo);
+  gl_named_framebuffer_renderbuffer(g_hl.fbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_hl.color);
+  gl_named_framebuffer_renderbuffer(g_hl.fbo, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_hl.depth);
+
+  gl_create_renderbuffers(1, &g_hl.res_color);
+  gl_named_renderbuffer_storage(g_hl.res_color, GL_RGBA8, g_w, g_h);
+  gl_create_framebuffers(1, &g_hl.res);
+  gl_named_framebuffer_renderbuffer(g_hl.res, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_hl.res_color);
+
+  if (gl_check_named_framebuffer_status(g_hl.fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    err("headless framebuffer is incomplete");
+  }
+
+  gl_bind_framebuffer(GL_FRAMEBUFFER, g_hl.fbo);
+  printf("headless: %s, %s, %dx%d\n", (char const *)gl_get_string(GL_RENDERER),
+         (char const *)gl_get_string(GL_VERSION), g_w, g_h);
+}
+#endif
+
+/**
+ * the frame as RGBA rows, bottom up
+ */
+void
+frame_read(uint8_t *px) {
+#ifdef HEADLESS
+  gl_blit_named_framebuffer(g_hl.fbo, g_hl.res, 0, 0, g_w, g_h, 0, 0, g_w, g_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  gl_bind_framebuffer(GL_READ_FRAMEBUFFER, g_hl.res);
+  gl_read_pixels(0, 0, g_w, g_h, GL_RGBA, GL_UNSIGNED_BYTE, px);
+  gl_bind_framebuffer(GL_READ_FRAMEBUFFER, g_hl.fbo);
+#else
+  gl_read_pixels(0, 0, g_w, g_h, GL_RGBA, GL_UNSIGNED_BYTE, px);
+#endif
+}
+
+void
+frame_save(char const *path) {
+  uint8_t *px = malloc((size_t)g_w * g_h * 4);
+  frame_read(px);
+  stbi_flip_vertically_on_write(1);
+  if (!stbi_write_png(path, g_w, g_h, 4, px, g_w * 4)) {
+    fprintf(stderr, "failed to write %s\n", path);
+  } else {
+    printf("wrote %s\n", path);
+  }
+
+  free(px);
+}
+
+/*-- benchmarks --*/
+
+/**
+ * the lookup shader_set_* did before handles, kept for comparison
+ */
+static int
+uni_linear(struct shader const *s, char const *name) {
+  for (int i = 0; i < s->n_unis; i++) {
+    if (strcmp(s->unis[i].name, name) == 0) return s->unis[i].loc;
+  }
+
+  return -1;
+}
+
+/**
+ * uniform updates per second on bary's u_t, through the old linear strcmp
+ * lookup, the hashed lookup by name and a handle. the lookups are timed on
+ * their own too, since the GL call can hide them
+ */
+void
+bench_uniforms(void) {
+  enum { n = 1 << 22 };
+  struct shader *s = &bary;
+  char const *name = "u_t";
+  volatile int sink = 0;
+
+  shader_use(s);
+  gl_finish();
+
+  double res[6];
+
+  for (int k = 0; k < 6; k++) {
+    double t0 = sys_time();
+    for (int i = 0; i < n; i++) {
+      int loc = k % 3 == 0 ? uni_linear(s, name)
+                : k % 3 == 1 ? shader_loc(s, name, GL_FLOAT, false)
+                : s->t.loc;
+      if (k < 3) {
+        gl_program_uniform_1f(s->id, loc, (float)i);
+      } else {
+        sink += loc;
+      }
+    }
+
+    gl_finish();
+    res[k] = sys_time() - t0;
+  }
+
+  char const *paths[] = {"strcmp scan", "perfect hash", "handle"};
+  printf("uniform updates, %d unis in the program\n", s->n_unis);
+  for (int k = 0; k < 3; k++) {
+    printf("  %-14s %8.1f M updates/s %10.1f M lookups/s\n",
+           paths[k], n / res[k] * 1e-6, n / res[k + 3] * 1e-6);
+  }
+}
+
+/**
+ * GPU time per frame for the points, lines and bary modes through their
+ * geometry shaders and through pull.vsh, over the same scene, and how
+ * many pixels the two paths' last frames differ in
+ */
+void
+bench_pull(void) {
+  enum { n_frames = 100, n_warm = 5 };
+
+  while (g_n_ready < g_n_assets) {
+    assets_poll();
+    thrd_yield();
+  }
+
+  g_t = 0.5f;
+  camera_tick(&camera);
+  frame_update(&camera);
+
+  unsigned q;
+  gl_gen_queries(1, &q);
+  size_t n_px = (size_t)g_w * g_h;
+  uint8_t *px[2] = {malloc(n_px * 4), malloc(n_px * 4)};
+
+  char const *names[] = {"points", "lines", "bary"};
+  printf("gpu ms/frame    geometry shader    pulled   differing pixels\n");
+  for (int mode = 0; mode < 3; mode++) {
+    double ms[2];
+    for (int path = 0; path < 2; path++) {
+      uint64_t total = 0;
+      for (int f = 0; f < n_warm + n_frames; f++) {
+        gl_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gl_begin_query(GL_TIME_ELAPSED, q);
+        ring_begin(&g_ring);
+
+        struct shader *s = g_modes[path][mode];
+        rq_push(&g_rq, s, &mesh);
+        rq_push(&g_rq, s, &tree);
+        stress_push(s);
+        rq_flush(&g_rq);
+        ring_end(&g_ring);
+
+        gl_end_query(GL_TIME_ELAPSED);
+        uint64_t ns;
+        gl_get_query_objectui_64v(q, GL_QUERY_RESULT, &ns);
+        if (f >= n_warm) total += ns;
+      }
+
+      ms[path] = total * 1e-6 / n_frames;
+      frame_read(px[path]);
+    }
+
+    size_t diff = 0;
+    for (size_t i = 0; i < n_px; i++) diff += memcmp(&px[0][i * 4], &px[1][i * 4], 4) != 0;
+    printf("  %-8s %15.3f %10.3f %18zu\n", names[mode], ms[0], ms[1], diff);
+  }
+
+  gl_delete_queries(1, &q);
+  free(px[0]);
+  free(px[1]);
+}
+
+/**
+ * replays a camera path once per mode, one frame per cam_dt of path
+ * whatever the frames take, and times each frame through glFinish so the
+ * GPU's share counts. prints min/avg/max and percentiles per mode, and
+ * writes every frame's time to trace as csv
+ */
+void
+bench_path(char const *path, char const *trace) {
+  enum { n_warm = 10 };
+
+  struct cam_path p;
+  cam_path_load(&p, path);
+  int n_frames = (int)(cam_path_len(&p) / cam_dt) + 1;
+
+  while (g_n_ready < g_n_assets) {
+    assets_poll();
+    thrd_yield();
+  }
+
+  FILE *fp = fopen(trace, "w");
+  if (!fp) err("failed to create %s", trace);
+  fprintf(fp, "mode,frame,t,ms\n");
+
+  printf("%s: %d frames of %.2f s over %d keys\n", path, n_frames, cam_path_len(&p), p.nkeys);
+  printf("  %-8s %9s %9s %9s %9s %9s %9s\n", "mode", "min ms", "avg ms", "p50 ms", "p95 ms", "p99 ms", "max ms");
+
+  float *ms = malloc(sizeof(float) * n_frames);
+  g_t = 1;
+  for (int mode = 0; mode < 5; mode++) {
+    g_n = mode;
+    cam_path_begin(&p, &camera);
+
+    for (int f = -n_warm; f < n_frames; f++) {
+      /* warm-up frames ease the camera, so the path proper starts over */
+      if (f == 0) cam_path_begin(&p, &camera);
+
+      double t0 = sys_time();
+      cam_path_at(&p, max(f, 0) * cam_dt, &camera);
+      camera_tick(&camera);
+      frame_draw(t0);
+      gl_finish();
+      if (f >= 0) ms[f] = (sys_time() - t0) * 1e3;
+
+#ifndef HEADLESS
+      glfw_poll_events();
+      glfw_swap_buffers(g_win);
+#endif
+      prof_frame();
+    }
+
+    double sum = 0;
+    for (int f = 0; f < n_frames; f++) {
+      sum += ms[f];
+      fprintf(fp, "%s,%d,%.4f,%.4f\n", g_mode_names[mode], f, f * cam_dt, ms[f]);
+    }
+
+    qsort(ms, n_frames, sizeof(float), float_cmp);
+    printf("  %-8s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", g_mode_names[mode], ms[0], sum / n_frames,
+           ms[n_frames / 2], ms[(n_frames - 1) * 95 / 100], ms[(n_frames - 1) * 99 / 100], ms[n_frames - 1]);
+  }
+
+  fclose(fp);
+  printf("wrote %s\n", trace);
+  free(ms);
+  free(p.keys);
+}
+
 /*-- main --*/
 
 int 
-main() {
+main(int argc, char **argv) {
+  g_t0 = sys_time();
+
+  int flags = obj_vt | obj_overdraw | obj_lod | (g_quant ? obj_quant : 0);
+  asset_load(&mesh, "./res/models/monkey.obj", flags);
+  asset_load(&tree, "./res/models/tree.obj", flags);
+
+#ifdef HEADLESS
+  headless_args(argc, argv);
+  headless_init();
+#else
   if (!glfw_init()) {
     err("failed to init glfw %d", 3);
   }
@@ -389,7 +2565,8 @@ main() {
 
   glfw_make_context_current(g_win);
 
-  if (!glad_load_gl_loader((GLADloadproc)glfw_get_proc_address)) {
+  g_get_proc = (GLADloadproc)glfw_get_proc_address;
+  if (!glad_load_gl_loader(g_get_proc)) {
     err("failed to load glad!");
   }
 
@@ -400,102 +2577,160 @@ main() {
   glfw_set_cursor_pos_callback(g_win, cursor_pos_cb);
   glfw_set_key_callback(g_win, key_cb);
   glfw_set_framebuffer_size_callback(g_win, fb_size_cb);
+#endif
 
   camera_new(&camera);
   camera.target_yaw = 180;
   camera.pos = (v3){0, 0, 4};
 
-  shader_new(&points, "./shaders/noop.vsh", "./shaders/noop.fsh", "./shaders/points.gsh");
-  shader_new(&lines, "./shaders/noop.vsh", "./shaders/noop.fsh", "./shaders/lines.gsh");
-  shader_new(&lines_transition, "./shaders/noop.vsh", "./shaders/lines_transition.fsh", "./shaders/lines.gsh");
-  shader_new(&bary, "./shaders/vp.vsh", "./shaders/color.fsh", "./shaders/bary.gsh");
-  shader_new(&norm, "./shaders/norm.vsh", "./shaders/norm.fsh", NULL);
-  shader_new(&lit, "./shaders/norm.vsh", "./shaders/lit.fsh", NULL);
+  shader_parallel_init();
+
+  frame_init();
+  insts_init();
+  ring_new(&g_ring, (size_t)4 << 20);
+  rq_init(&g_rq);
+
+  char *frame = read_txt_file_len("./shaders/frame.glsl", NULL);
+  char defs[4096];
+  snprintf(defs, sizeof(defs), "%s%s", g_quant ? "#define QUANT\n" : "", frame);
+  free(frame);
+  shader_new(&points, "./shaders/noop.vsh", "./shaders/noop.fsh", "./shaders/points.gsh", defs);
+  shader_new(&lines, "./shaders/noop.vsh", "./shaders/noop.fsh", "./shaders/lines.gsh", defs);
+  shader_new(&lines_transition, "./shaders/noop.vsh", "./shaders/lines_transition.fsh", "./shaders/lines.gsh", defs);
+  shader_new(&bary, "./shaders/vp.vsh", "./shaders/color.fsh", "./shaders/bary.gsh", defs);
+  shader_new(&norm, "./shaders/norm.vsh", "./shaders/norm.fsh", NULL, defs);
+  shader_new(&lit, "./shaders/norm.vsh", "./shaders/lit.fsh", NULL, defs);
+
+  char defs_lines[sizeof(defs) + 32], defs_bary[sizeof(defs) + 32];
+  snprintf(defs_lines, sizeof(defs_lines), "%s#define LINES\n", defs);
+  snprintf(defs_bary, sizeof(defs_bary), "%s#define BARY\n", defs);
+  shader_new(&points_pull, "./shaders/pull.vsh", "./shaders/noop.fsh", NULL, defs);
+  shader_new(&lines_pull, "./shaders/pull.vsh", "./shaders/noop.fsh", NULL, defs_lines);
+  shader_new(&bary_pull, "./shaders/pull.vsh", "./shaders/color.fsh", NULL, defs_bary);
+  shader_pulls(&points_pull, GL_POINTS, 3, &points);
+  shader_pulls(&lines_pull, GL_LINES, 6, &lines);
+  shader_pulls(&bary_pull, GL_TRIANGLES, 3, &bary);
+  hud_init(defs);
+  printf("shaders: %d programs submitted in %.1f ms, %d from ./cache/, parallel compile %s\n",
+         g_n_programs, (sys_time() - g_t_shaders) * 1e3, g_n_cached, g_parallel_compile ? "on" : "off");
+
+  bool bench_pulled = false;
+  char const *bench_cam = NULL, *trace = "./bench_path.csv";
+  for (int i = 1; i < argc; i++) {
+    bench_pulled |= strcmp(argv[i], "--bench-pull") == 0;
+    if (strcmp(argv[i], "--bench-uniforms") == 0) {
+      bench_uniforms();
+      return 0;
+    }
+
+    if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      hud_csv(argv[++i]);
+    }
+
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      cam_path_record(&g_rec, argv[++i]);
+    }
 
-  mesh_gpu_new(&mesh.g, 2, attr_3f, attr_3f);
+    /* replays a path and exits; --trace sets where per-frame times go */
+    if (strcmp(argv[i], "--bench-path") == 0 && i + 1 < argc) {
+      bench_cam = argv[++i];
+#ifndef HEADLESS
+      glfw_swap_interval(0);
+#endif
+    }
 
-  mesh_from_obj(&mesh, "./res/models/monkey.obj", true);
+    if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace = argv[++i];
+    }
 
-  struct mesh tree;
-  mesh_gpu_new(&tree.g, 2, attr_3f, attr_3f);
-  mesh_from_obj(&tree, "./res/models/tree.obj", true);
+    /* frame times mean nothing when vsync caps them */
+    if (strcmp(argv[i], "--stress") == 0) {
+      stress_new(i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[++i]) : 100000);
+#ifndef HEADLESS
+      glfw_swap_interval(0);
+#endif
+    }
+  }
 
   gl_viewport(0, 0, g_w, g_h);
-  
   gl_point_size(8);
   gl_line_width(2);
   gl_enable(GL_DEPTH_TEST);
 
-  while (!glfw_window_should_close(g_win)) {
-    gl_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (bench_pulled) {
+    bench_pull();
+    return 0;
+  }
+
+  if (bench_cam) {
+    bench_path(bench_cam, trace);
+    return 0;
+  }
 
+  int n_frames = 0;
+  double t_stats = sys_time();
+
+#ifdef HEADLESS
+  while (g_n_ready < g_n_assets) {
+    assets_poll();
+    thrd_yield();
+  }
+
+  for (int frame = 0; frame < g_hl.frames; frame++) {
+#else
+  while (!glfw_window_should_close(g_win)) {
+#endif
+    double t_frame = sys_time();
+#ifndef HEADLESS
     camera_move(&camera);
+#endif
+    cam_path_write(&g_rec, &camera);
     camera_tick(&camera);
 
     g_t = lerp(g_t, 1, 0.05);
+    frame_draw(t_frame);
 
-    switch (g_n) {
-      case 4:
-        gl_use_program(lit.id);
-        shader_set_m4f(&lit, "u_vp", &camera.vp);
-        shader_set_3f(&lit, "u_eye", camera.pos);
-        shader_set_1f(&lines, "u_time", g_t);
-  
-        gl_bind_vertex_array(mesh.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, mesh.n_data);
-
-        gl_bind_vertex_array(tree.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, tree.n_data);
-        break;
-      case 3:
-        gl_use_program(norm.id);
-        shader_set_m4f(&norm, "u_vp", &camera.vp);
-        shader_set_1f(&lines, "u_time", g_t);
-  
-        gl_bind_vertex_array(mesh.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, mesh.n_data);
-
-        gl_bind_vertex_array(tree.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, tree.n_data);
-        break;
-      case 2:
-        gl_use_program(bary.id);
-        shader_set_m4f(&bary, "u_vp", &camera.vp);
-        shader_set_1f(&bary, "u_t", 1);
-        shader_set_2f(&bary, "u_size", (v2){g_w, g_h});
-  
-        gl_bind_vertex_array(mesh.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, mesh.n_data);
-
-        gl_bind_vertex_array(tree.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, tree.n_data);
-        break;
-      case 1:
-        gl_use_program(lines.id);
-        shader_set_m4f(&lines, "u_vp", &camera.vp);
-        shader_set_1f(&lines, "u_time", g_t);
-  
-        gl_bind_vertex_array(mesh.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, mesh.n_data);
-
-        gl_bind_vertex_array(tree.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, tree.n_data);
-        break;
-      case 0:
-        gl_use_program(points.id);
-        shader_set_m4f(&points, "u_vp", &camera.vp);
-
-        gl_bind_vertex_array(mesh.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, mesh.n_data);
-
-        gl_bind_vertex_array(tree.g.va);
-        gl_draw_arrays(GL_TRIANGLES, 0, tree.n_data);
-        break;
-    }
-
+#ifdef HEADLESS
+    gl_finish();
+    printf("frame %d: %.2f ms\n", frame, (sys_time() - t_frame) * 1e3);
+#else
     glfw_poll_events();
     glfw_swap_buffers(g_win);
+#endif
+    prof_frame();
+
+    if (g_first_frame) {
+      printf("startup: first frame after %.1f ms\n", (sys_time() - g_t0) * 1e3);
+      g_first_frame = false;
+    }
+
+    n_frames++;
+    if (sys_time() - t_stats >= 1) {
+      if (g_stress.n) {
+        printf("frame: %.2f ms, %s\n", (sys_time() - t_stats) * 1e3 / n_frames,
+               g_stress_inst ? "instanced" : "one draw per copy");
+      }
+
+      printf("triangles/frame: %lld submitted, %lld without lod\n",
+             (long long)(g_tris[0] / n_frames), (long long)(g_tris[1] / n_frames));
+      printf("per frame: %.1f draws of %.1f commands, %.1f program switches, %.1f vao binds\n",
+             (double)g_rq_stats.draws / n_frames, (double)g_rq_stats.cmds / n_frames,
+             (double)g_rq_stats.programs / n_frames, (double)g_rq_stats.vaos / n_frames);
+      printf("ring: %.1f KB/frame streamed, %d fence waits, %.2f ms waiting\n",
+             g_ring.streamed / 1024. / n_frames, g_ring.waits, g_ring.wait_ms);
+      g_tris[0] = g_tris[1] = 0;
+      g_ring.streamed = g_ring.waits = 0;
+      g_ring.wait_ms = 0;
+      g_rq_stats.draws = g_rq_stats.cmds = g_rq_stats.programs = g_rq_stats.vaos = 0;
+      n_frames = 0;
+      t_stats = sys_time();
+    }
   }
 
+#ifdef HEADLESS
+  frame_save(g_hl.out);
+#endif
+  hud_close();
+  if (g_rec.rec) fclose(g_rec.rec);
   return 0;
 }
@@ -0,0 +1,1172 @@
+#pragma once
+
+#include "typedefs.h"
+#include "lib/glfw/deps/tinycthread.h"
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "prof.h"
+
+/*
+ * everything the loader and geom.h allocate shows up in the profiler's
+ * memory view. system headers go above so their declarations are left alone
+ */
+#if PROF
+#define malloc prof_malloc
+#define calloc prof_calloc
+#define realloc prof_realloc
+#define free prof_free
+#endif
+
+/* after the defines, so geom.h's buffers are tracked like the ones they are freed with */
+#include "geom.h"
+
+static int
+sys_n_cores(void) {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/**
+ * creates path if it isn't there yet
+ */
+static void
+sys_mkdir(char const *path) {
+#ifdef _WIN32
+  CreateDirectoryA(path, NULL);
+#else
+  mkdir(path, 0755);
+#endif
+}
+
+/*-- file mapping --*/
+
+struct file_map {
+  char const *data;
+  size_t len;
+#ifdef _WIN32
+  HANDLE file, map;
+#endif
+};
+
+/**
+ * maps a whole file read-only. returns false if it can't be opened, so
+ * callers can probe for optional files. empty files map to data = NULL
+ */
+static bool
+file_map_open(struct file_map *dst, char const *path) {
+  *dst = (struct file_map){0};
+
+#ifdef _WIN32
+  dst->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (dst->file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(dst->file, &size);
+  dst->len = (size_t)size.QuadPart;
+  if (dst->len == 0) return true;
+
+  dst->map = CreateFileMappingA(dst->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (dst->map) dst->data = MapViewOfFile(dst->map, FILE_MAP_READ, 0, 0, 0);
+  if (!dst->data) {
+    if (dst->map) CloseHandle(dst->map);
+    CloseHandle(dst->file);
+    return false;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    dst->len = (size_t)st.st_size;
+    void *p = mmap(NULL, dst->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, dst->len, MADV_WILLNEED);
+      dst->data = p;
+    }
+  }
+
+  close(fd);
+  if (dst->len && !dst->data) return false;
+#endif
+
+  return true;
+}
+
+static void
+file_map_close(struct file_map *m) {
+#ifdef _WIN32
+  if (m->data) UnmapViewOfFile(m->data);
+  if (m->map) CloseHandle(m->map);
+  if (m->file && m->file != INVALID_HANDLE_VALUE) CloseHandle(m->file);
+#else
+  if (m->data) munmap((void *)m->data, m->len);
+#endif
+  *m = (struct file_map){0};
+}
+
+/**
+ * maps len bytes of writable scratch space backed by a temp file that is
+ * gone once it's closed. the os can write its pages out and drop them
+ * under pressure, unlike the heap
+ */
+static bool
+file_map_scratch(struct file_map *dst, size_t len) {
+  *dst = (struct file_map){.len = len};
+
+#ifdef _WIN32
+  char dir[MAX_PATH], path[MAX_PATH];
+  if (!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, "obj", 0, path)) return false;
+
+  dst->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_DELETE_ON_CLOSE, NULL);
+  if (dst->file == INVALID_HANDLE_VALUE) return false;
+
+  dst->map = CreateFileMappingA(dst->file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)len >> 32), (DWORD)len, NULL);
+  if (dst->map) dst->data = MapViewOfFile(dst->map, FILE_MAP_WRITE, 0, 0, len);
+  if (!dst->data) {
+    if (dst->map) CloseHandle(dst->map);
+    CloseHandle(dst->file);
+    return false;
+  }
+#else
+  FILE *fp = tmpfile();
+  if (!fp) return false;
+
+  void *p = MAP_FAILED;
+  if (ftruncate(fileno(fp), (off_t)len) == 0) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(fp), 0);
+  }
+
+  /* tmpfile is already unlinked, the mapping keeps it alive */
+  fclose(fp);
+  if (p == MAP_FAILED) return false;
+  dst->data = p;
+#endif
+
+  return true;
+}
+
+/**
+ * size in bytes, or -1 if the file can't be stat'ed
+ */
+static int64_t
+file_size(char const *path) {
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA fa;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fa)) return -1;
+  return (int64_t)fa.nFileSizeHigh << 32 | fa.nFileSizeLow;
+#else
+  struct stat st;
+  return stat(path, &st) == 0 ? (int64_t)st.st_size : -1;
+#endif
+}
+
+/*-- tokenizing --*/
+
+/**
+ * finds the next '\n' in [s, end), or end. vt, s and comment lines are
+ * skipped with this, so it's worth doing 16 bytes at a time
+ */
+static char const *
+obj_eol(char const *s, char const *end) {
+#ifdef __SSE2__
+  __m128i nl = _mm_set1_epi8('\n');
+  for (; end - s >= 16; s += 16) {
+    int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)s), nl));
+    if (m) return s + __builtin_ctz(m);
+  }
+#endif
+
+  while (s < end && *s != '\n') s++;
+  return s;
+}
+
+[[gnu::always_inline]]
+
+inline static char const *
+obj_ws(char const *s, char const *end) {
+  while (s < end && (*s == ' ' || *s == '\t')) s++;
+  return s;
+}
+
+static double const obj_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * decimal to float without a terminator or locale. mantissas up to 2^53
+ * with exponents up to 22 are exact in double (clinger's fast path), and
+ * narrowing that to float is only ambiguous when it lands exactly halfway
+ * between two floats. that and everything else (long mantissas, inf, nan)
+ * goes through strtof on a copy of the token, so results match strtof
+ */
+static char const *
+obj_float(char const *s, char const *end, float *dst) {
+  s = obj_ws(s, end);
+  char const *beg = s;
+
+  bool neg = false;
+  if (s < end && (*s == '-' || *s == '+')) neg = *s++ == '-';
+
+  uint64_t m = 0;
+  int nd = 0, e = 0;
+  bool any = false, exact = true;
+
+  for (; s < end && (unsigned)(*s - '0') < 10; s++, any = true) {
+    if (nd < 19) m = m * 10 + (*s - '0'), nd += m != 0;
+    else e++, exact &= *s == '0';
+  }
+
+  if (s < end && *s == '.') {
+    for (s++; s < end && (unsigned)(*s - '0') < 10; s++, any = true) {
+      if (nd < 19) m = m * 10 + (*s - '0'), nd += m != 0, e--;
+      else exact &= *s == '0';
+    }
+  }
+
+  if (any && s < end && (*s == 'e' || *s == 'E')) {
+    char const *r = s + 1;
+    bool eneg = false;
+    if (r < end && (*r == '-' || *r == '+')) eneg = *r++ == '-';
+
+    if (r < end && (unsigned)(*r - '0') < 10) {
+      int x = 0;
+      for (; r < end && (unsigned)(*r - '0') < 10; r++) {
+        if (x < 10000) x = x * 10 + (*r - '0');
+      }
+
+      e += eneg ? -x : x;
+      s = r;
+    }
+  }
+
+  if (any && exact && m <= (1ull << 53) && e >= -22 && e <= 22) {
+    double d = e < 0 ? (double)m / obj_pow10[-e] : (double)m * obj_pow10[e];
+
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    if (d == 0 || (bits & 0x1fffffff) != 0x10000000) {
+      *dst = neg ? -(float)d : (float)d;
+      return s;
+    }
+  }
+
+  char buf[64];
+  char const *r = any ? s : beg;
+  while (!any && r < end && r - beg < 63 && *r != ' ' && *r != '\t' && *r != '\r' && *r != '\n') r++;
+
+  size_t len = min((size_t)(r - beg), sizeof(buf) - 1);
+  memcpy(buf, beg, len);
+  buf[len] = '\0';
+
+  char *e_ptr;
+  *dst = strtof(buf, &e_ptr);
+  return beg + (e_ptr - buf);
+}
+
+static char const *
+obj_int(char const *s, char const *end, long *dst) {
+  s = obj_ws(s, end);
+
+  bool neg = false;
+  if (s < end && (*s == '-' || *s == '+')) neg = *s++ == '-';
+
+  long i = 0;
+  for (; s < end && (unsigned)(*s - '0') < 10; s++) {
+    i = i * 10 + (*s - '0');
+  }
+
+  *dst = neg ? -i : i;
+  return s;
+}
+
+/*-- parsing --*/
+
+/**
+ * one face as read from the file, before the position/normal pools are
+ * merged. indices are zero-based and global unless the matching bit of
+ * rel is set, in which case they count from the start of the owning chunk
+ * (obj's negative indices)
+ */
+struct obj_face {
+  int p[3], n[3];
+  int rel;
+};
+
+struct obj_chunk {
+  char const *beg, *end;
+  bool t;
+
+  int np, nn, nf;
+  v3 *p, *n;
+  struct obj_face *f;
+
+  /* filled by the merge, read by the resolve */
+  int p_base, n_base, f_base;
+  int gnp, gnn;
+  v3 const *gp, *gn;
+  struct vt *out;
+};
+
+static char const *
+obj_idx(char const *s, char const *end, int local, int *dst, bool *rel) {
+  long i;
+  s = obj_int(s, end, &i);
+  *rel = i < 0;
+  *dst = i < 0 ? local + (int)i : (int)i - 1;
+  return s;
+}
+
+static int
+obj_parse_chunk(void *arg) {
+  prof_begin(zone, "obj_parse_chunk");
+  struct obj_chunk *c = arg;
+  char const *end = c->end;
+
+  int np = 0, cp = 4;
+  v3 *p = malloc(sizeof(v3) * cp);
+
+  int nn = 0, cn = 4;
+  v3 *n = malloc(sizeof(v3) * cn);
+
+  int nf = 0, cf = 4;
+  struct obj_face *f = malloc(sizeof(struct obj_face) * cf);
+
+  char const *s = c->beg;
+  while (s < end) {
+    char c0 = s[0], c1 = end - s > 1 ? s[1] : 0;
+    char const *r = s;
+
+    if (c0 == 'v' && c1 == ' ') {
+      resize(p);
+      r = obj_float(s + 2, end, &p[np].x);
+      r = obj_float(r, end, &p[np].y);
+      r = obj_float(r, end, &p[np].z);
+      np++;
+    } else if (c0 == 'v' && c1 == 'n') {
+      resize(n);
+      r = obj_float(s + 3, end, &n[nn].x);
+      r = obj_float(r, end, &n[nn].y);
+      r = obj_float(r, end, &n[nn].z);
+      v3_norm(&n[nn]);
+      nn++;
+    } else if (c0 == 'f' && c1 == ' ') {
+      resize(f);
+      struct obj_face *o = &f[nf++];
+      o->rel = 0;
+
+      r = s + 2;
+      for (int i = 0; i < 3; i++) {
+        bool rp, rn, rt;
+        int dummy;
+        r = obj_idx(r, end, np, &o->p[i], &rp);
+        if (r < end && *r == '/') r++;
+        if (c->t) r = obj_idx(r, end, 0, &dummy, &rt);
+        if (r < end && *r == '/') r++;
+        r = obj_idx(r, end, nn, &o->n[i], &rn);
+        o->rel |= rp << i | rn << (i + 3);
+      }
+    }
+
+    s = obj_eol(r, end) + 1;
+  }
+
+  c->np = np, c->p = p;
+  c->nn = nn, c->n = n;
+  c->nf = nf, c->f = f;
+  prof_end(zone);
+  return 0;
+}
+
+static int
+obj_resolve_chunk(void *arg) {
+  struct obj_chunk *c = arg;
+  struct vt *v = c->out + (size_t)c->f_base * 3;
+
+  for (int i = 0; i < c->nf; i++) {
+    struct obj_face *o = &c->f[i];
+    for (int j = 0; j < 3; j++) {
+      int pi = o->p[j] + (o->rel >> j & 1 ? c->p_base : 0);
+      int ni = o->n[j] + (o->rel >> (j + 3) & 1 ? c->n_base : 0);
+      if (pi < 0 || pi >= c->gnp || ni < 0 || ni >= c->gnn) {
+        err("face index out of range (p %d/%d, n %d/%d)", pi, c->gnp, ni, c->gnn);
+      }
+
+      v->p = c->gp[pi];
+      v->n = c->gn[ni];
+      v++;
+    }
+  }
+
+  return 0;
+}
+
+static void
+obj_run(struct obj_chunk *chunks, int k, thrd_start_t fn) {
+  thrd_t th[k];
+  for (int i = 1; i < k; i++) {
+    if (thrd_create(&th[i], fn, &chunks[i]) != thrd_success) {
+      err("failed to spawn loader thread %d", i);
+    }
+  }
+
+  fn(&chunks[0]);
+
+  for (int i = 1; i < k; i++) {
+    thrd_join(th[i], NULL);
+  }
+}
+
+/**
+ * parses the v/vn/f records in src into a flat triangle list, three
+ * struct vt per face. src is split into line-aligned chunks that are
+ * parsed on up to n_threads cores (0 for all of them); a prefix sum over
+ * the per-chunk counts then gives every chunk its slice of the merged
+ * pools and of the output
+ */
+static struct vt *
+obj_parse_mem(char const *src, size_t len, bool t, int n_threads, int *n_out) {
+  enum { min_chunk = 1 << 16 };
+  if (n_threads <= 0) n_threads = sys_n_cores();
+  int k = (int)min((size_t)n_threads, len / min_chunk + 1);
+  struct obj_chunk chunks[k];
+
+  char const *beg = src, *last = src + len;
+  for (int i = 0; i < k; i++) {
+    char const *end = src + len * (i + 1) / k;
+    if (end > beg && end < last && end[-1] != '\n') {
+      end = obj_eol(end, last) + 1;
+      if (end > last) end = last;
+    }
+    if (end < beg) end = beg;
+
+    chunks[i] = (struct obj_chunk){.beg = beg, .end = end, .t = t};
+    beg = end;
+  }
+
+  obj_run(chunks, k, obj_parse_chunk);
+
+  int np = 0, nn = 0, nf = 0;
+  for (int i = 0; i < k; i++) {
+    chunks[i].p_base = np, np += chunks[i].np;
+    chunks[i].n_base = nn, nn += chunks[i].nn;
+    chunks[i].f_base = nf, nf += chunks[i].nf;
+  }
+
+  v3 *p = malloc(sizeof(v3) * max(np, 1));
+  v3 *n = malloc(sizeof(v3) * max(nn, 1));
+  struct vt *v = malloc(sizeof(struct vt) * 3 * max(nf, 1));
+
+  for (int i = 0; i < k; i++) {
+    struct obj_chunk *c = &chunks[i];
+    memcpy(p + c->p_base, c->p, sizeof(v3) * c->np);
+    memcpy(n + c->n_base, c->n, sizeof(v3) * c->nn);
+    free(c->p);
+    free(c->n);
+
+    c->gnp = np, c->gp = p;
+    c->gnn = nn, c->gn = n;
+    c->out = v;
+  }
+
+  obj_run(chunks, k, obj_resolve_chunk);
+
+  for (int i = 0; i < k; i++) {
+    free(chunks[i].f);
+  }
+
+  free(p);
+  free(n);
+
+  *n_out = nf * 3;
+  return v;
+}
+
+/**
+ * the default path: maps the file and tokenizes it in place
+ */
+static struct vt *
+obj_parse(char const *file, bool t, int n_threads, int *n_out) {
+  struct file_map fm;
+  if (!file_map_open(&fm, file)) {
+    err("failed to map %s", file);
+  }
+
+  struct vt *v = obj_parse_mem(fm.data, fm.len, t, n_threads, n_out);
+  file_map_close(&fm);
+  return v;
+}
+
+/**
+ * the original fgets/sscanf loader, single threaded. lines are cut at 128
+ * bytes. kept as the reference the other paths are checked and
+ * benchmarked against
+ */
+static struct vt *
+obj_parse_stdio(char const *file, bool t, int *n_out) {
+  int np = 0, cp = 4;
+  v3 *p = malloc(sizeof(v3) * cp);
+
+  int nn = 0, cn = 4;
+  v3 *n = malloc(sizeof(v3) * cn);
+
+  int nv = 0, cv = 4;
+  struct vt *v = malloc(sizeof(struct vt) * cv);
+
+  FILE *fp = fopen(file, "r");
+  if (!fp) {
+    err("failed to open %s", file);
+  }
+
+  char buf[128];
+
+  while (fgets(buf, sizeof(buf), fp)) {
+    if (buf[0] == 'v') {
+      if (buf[1] == ' ') {
+        resize(p);
+        sscanf(buf, "v %f %f %f", &p[np].x, &p[np].y, &p[np].z);
+        np++;
+      } else if (buf[1] == 'n') {
+        resize(n);
+        sscanf(buf, "vn %f %f %f", &n[nn].x, &n[nn].y, &n[nn].z);
+        v3_norm(&n[nn]);
+        nn++;
+      }
+    } else if (buf[0] == 'f') {
+      int p0, n0, p1, n1, p2, n2;
+      int dummy;
+      if (t) {
+        sscanf(buf, "f %d/%d/%d %d/%d/%d %d/%d/%d", &p0, &dummy, &n0, &p1, &dummy, &n1, &p2, &dummy, &n2);
+      } else {
+        sscanf(buf, "f %d//%d %d//%d %d//%d", &p0, &n0, &p1, &n1, &p2, &n2);
+      }
+
+      p0--, n0--, p1--, n1--, p2--, n2--;
+
+      resize(v);
+      v[nv++] = (struct vt){p[p0], n[n0]};
+
+      resize(v);
+      v[nv++] = (struct vt){p[p1], n[n1]};
+
+      resize(v);
+      v[nv++] = (struct vt){p[p2], n[n2]};
+    }
+  }
+
+  fclose(fp);
+  free(p);
+  free(n);
+
+  *n_out = nv;
+  return v;
+}
+
+/*-- loading --*/
+
+enum obj_flag {
+  /* faces are v/vt/vn rather than v//vn */
+  obj_vt = 1 << 0,
+  /* after the vertex cache pass, sort its clusters to cut overdraw */
+  obj_overdraw = 1 << 1,
+  /* store vertices as struct vtq instead of struct vt */
+  obj_quant = 1 << 2,
+  /* import through struct obj_stream in bounded memory; only obj_vt applies */
+  obj_stream = 1 << 3,
+  /* build coarser levels with geom_lod after the full-detail one */
+  obj_lod = 1 << 4,
+};
+
+/**
+ * bump whenever the parser's output changes, so stale caches get rebuilt
+ */
+enum { obj_version = 5 };
+
+/**
+ * obj_lod's error thresholds for the levels past the first, as fractions
+ * of the bounding box diagonal, and how much a normal flipping around
+ * counts against moving a vertex by the diagonal. both are part of the
+ * cache key
+ */
+static float const obj_lod_errs[geom_max_lods - 1] = {0.004f, 0.008f, 0.016f, 0.032f};
+static float const obj_lod_nw = 0.02f;
+
+struct obj_cache_hdr {
+  char magic[4];
+  uint32_t version, src_hash, flags, ind_size;
+  uint64_t src_len;
+  v3 lo, hi;
+  float acmr[2], atvr[2];
+  float lod_errs[geom_max_lods - 1], lod_nw;
+  uint32_t n_lods, lod_off[geom_max_lods + 1];
+  float lod_err[geom_max_lods];
+  uint64_t n_data, data_off;
+  uint64_t n_inds, inds_off;
+};
+
+/**
+ * a loaded, welded and reordered mesh. data holds struct vt, or struct vtq
+ * with obj_quant (vt_size tells which); inds are ind_size (2 or 4) bytes
+ * each. acmr/atvr hold the vertex cache stats before [0] and after [1]
+ * reordering. inds holds n_lods levels back to back, level i from
+ * lod_off[i] to lod_off[i + 1] with lod_err[i] as its error in mesh units
+ * (0 for the first). when it came from the cache, data and inds point
+ * into map instead of the heap
+ */
+struct obj_mesh {
+  int n_data, n_inds, vt_size, ind_size;
+  void *data;
+  void *inds;
+  v3 lo, hi;
+  float acmr[2], atvr[2];
+  int n_lods, lod_off[geom_max_lods + 1];
+  float lod_err[geom_max_lods];
+  struct file_map map;
+};
+
+static void
+obj_mesh_free(struct obj_mesh *m) {
+  if (m->map.data) {
+    file_map_close(&m->map);
+  } else {
+    free(m->data);
+    free(m->inds);
+  }
+
+  *m = (struct obj_mesh){0};
+}
+
+static int
+obj_vt_size(int flags) {
+  return flags & obj_quant ? sizeof(struct vtq) : sizeof(struct vt);
+}
+
+static void
+obj_bounds(struct obj_mesh *m) {
+  struct vt const *v = m->data;
+  m->lo = (v3){INFINITY, INFINITY, INFINITY};
+  m->hi = v3_neg(m->lo);
+  for (int i = 0; i < m->n_data; i++) {
+    m->lo = v3_min(m->lo, v[i].p);
+    m->hi = v3_max(m->hi, v[i].p);
+  }
+}
+
+static bool
+obj_cache_read(struct obj_mesh *dst, char const *path, uint32_t hash, size_t src_len, int flags) {
+  struct file_map fm;
+  if (!file_map_open(&fm, path)) return false;
+
+  struct obj_cache_hdr const *h = (void const *)fm.data;
+  bool ok = fm.len >= sizeof(*h)
+            && memcmp(h->magic, "OBJC", 4) == 0
+            && h->version == obj_version
+            && h->src_hash == hash
+            && h->src_len == src_len
+            && h->flags == (uint32_t)flags
+            && memcmp(h->lod_errs, obj_lod_errs, sizeof(obj_lod_errs)) == 0
+            && h->lod_nw == obj_lod_nw
+            && h->n_lods >= 1 && h->n_lods <= geom_max_lods
+            && h->lod_off[0] == 0 && h->lod_off[h->n_lods] == h->n_inds
+            && (h->ind_size == 2 || h->ind_size == 4)
+            && h->data_off + h->n_data * obj_vt_size(flags) <= fm.len
+            && h->inds_off + h->n_inds * h->ind_size <= fm.len;
+
+  /* every level has to be whole triangles inside inds, or its draw range would read past them */
+  for (uint32_t i = 0; ok && i < h->n_lods; i++) {
+    ok = h->lod_off[i] <= h->lod_off[i + 1] && h->lod_off[i + 1] <= h->n_inds && h->lod_off[i + 1] % 3 == 0;
+  }
+
+  if (!ok) {
+    file_map_close(&fm);
+    return false;
+  }
+
+  *dst = (struct obj_mesh){
+    .n_data = (int)h->n_data,
+    .n_inds = (int)h->n_inds,
+    .vt_size = obj_vt_size(flags),
+    .ind_size = (int)h->ind_size,
+    .data = (void *)(fm.data + h->data_off),
+    .inds = h->n_inds ? (void *)(fm.data + h->inds_off) : NULL,
+    .lo = h->lo,
+    .hi = h->hi,
+    .acmr = {h->acmr[0], h->acmr[1]},
+    .atvr = {h->atvr[0], h->atvr[1]},
+    .n_lods = (int)h->n_lods,
+    .map = fm,
+  };
+
+  for (int i = 0; i <= dst->n_lods; i++) {
+    dst->lod_off[i] = (int)h->lod_off[i];
+    if (i < dst->n_lods) dst->lod_err[i] = h->lod_err[i];
+  }
+
+  return true;
+}
+
+static void
+obj_cache_write(struct obj_mesh const *m, char const *path, uint32_t hash, size_t src_len, int flags) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    fprintf(stderr, "obj: can't write cache %s\n", path);
+    return;
+  }
+
+  size_t data_len = (size_t)m->n_data * m->vt_size;
+  struct obj_cache_hdr h = {
+    .magic = {'O', 'B', 'J', 'C'},
+    .version = obj_version,
+    .src_hash = hash,
+    .flags = flags,
+    .ind_size = m->ind_size,
+    .src_len = src_len,
+    .lo = m->lo,
+    .hi = m->hi,
+    .acmr = {m->acmr[0], m->acmr[1]},
+    .atvr = {m->atvr[0], m->atvr[1]},
+    .lod_nw = obj_lod_nw,
+    .n_lods = m->n_lods,
+    .n_data = m->n_data,
+    .data_off = sizeof(h),
+    .n_inds = m->n_inds,
+    .inds_off = sizeof(h) + data_len,
+  };
+
+  memcpy(h.lod_errs, obj_lod_errs, sizeof(obj_lod_errs));
+  for (int i = 0; i <= m->n_lods; i++) {
+    h.lod_off[i] = m->lod_off[i];
+    if (i < m->n_lods) h.lod_err[i] = m->lod_err[i];
+  }
+
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+            && fwrite(m->data, 1, data_len, fp) == data_len
+            && fwrite(m->inds, m->ind_size, m->n_inds, fp) == (size_t)m->n_inds;
+
+  /* a torn write would be rejected by the size checks, but don't leave one */
+  if (fclose(fp) != 0 || !ok) remove(path);
+}
+
+/**
+ * welds the triangle soup of struct vt in dst, reorders it for the vertex
+ * cache (and overdraw with obj_overdraw), adds the obj_lod levels after it
+ * and picks the index size. the stats are for the first level
+ */
+static void
+obj_optimize(struct obj_mesh *dst, int flags) {
+  int n = dst->n_data;
+  uint32_t *inds = geom_weld(dst->data, &dst->n_data);
+  geom_cache_stats(inds, n, dst->n_data, &dst->acmr[0], &dst->atvr[0]);
+
+  int n_bounds, *bounds = malloc(sizeof(int) * (n / 3 + 1));
+  geom_tipsify(inds, n, dst->n_data, bounds, &n_bounds);
+  if (flags & obj_overdraw) {
+    geom_overdraw(inds, n, dst->data, dst->n_data, bounds, n_bounds, 1.05f);
+  }
+
+  free(bounds);
+
+  dst->n_lods = 1;
+  dst->lod_off[0] = 0;
+  dst->lod_err[0] = 0;
+  dst->n_inds = n;
+
+  if (flags & obj_lod) {
+    obj_bounds(dst);
+    float diag = v3_dist(dst->lo, dst->hi), errs[geom_max_lods - 1];
+    for (int i = 0; i < geom_max_lods - 1; i++) {
+      errs[i] = obj_lod_errs[i] * diag;
+    }
+
+    int off[geom_max_lods];
+    uint32_t *lods = malloc(sizeof(uint32_t) * max(n * (geom_max_lods - 1), 1));
+    int k = geom_lod(inds, n, dst->data, dst->n_data, errs, geom_max_lods - 1, obj_lod_nw * diag, lods, off, dst->lod_err + 1);
+
+    inds = realloc(inds, sizeof(uint32_t) * (n + off[k]));
+    for (int i = 0; i < k; i++) {
+      int len = off[i + 1] - off[i];
+      geom_tipsify(lods + off[i], len, dst->n_data, NULL, NULL);
+      memcpy(inds + n + off[i], lods + off[i], sizeof(uint32_t) * len);
+      dst->lod_off[i + 1] = n + off[i];
+    }
+
+    free(lods);
+    dst->n_lods += k;
+    dst->n_inds += off[k];
+  }
+
+  dst->lod_off[dst->n_lods] = dst->n_inds;
+
+  dst->n_data = geom_fetch(inds, dst->n_inds, dst->data, dst->n_data);
+  dst->data = realloc(dst->data, sizeof(struct vt) * max(dst->n_data, 1));
+  geom_cache_stats(inds, n, dst->n_data, &dst->acmr[1], &dst->atvr[1]);
+
+  dst->ind_size = geom_narrow(inds, dst->n_inds, dst->n_data);
+  dst->inds = inds;
+}
+
+/**
+ * loads and optimizes an obj through its binary cache at <file>.cache.
+ * the cache is keyed by the murmur3 hash of the source bytes, the flags
+ * and obj_version, and is rebuilt whenever any of them change
+ */
+static void
+obj_load(struct obj_mesh *dst, char const *file, int flags) {
+  prof_begin(zone, "obj_load");
+  double t0 = sys_time();
+
+  struct file_map src;
+  if (!file_map_open(&src, file)) {
+    err("failed to map %s", file);
+  }
+
+  uint32_t hash = hash_murmur3(src.data, src.len);
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s.cache", file);
+
+  bool cached = obj_cache_read(dst, path, hash, src.len, flags);
+  if (!cached) {
+    *dst = (struct obj_mesh){0};
+    dst->data = obj_parse_mem(src.data, src.len, flags & obj_vt, 0, &dst->n_data);
+    obj_optimize(dst, flags);
+    obj_bounds(dst);
+
+    dst->vt_size = obj_vt_size(flags);
+    if (flags & obj_quant) {
+      struct vtq *q = malloc(sizeof(struct vtq) * max(dst->n_data, 1));
+      geom_quantize(dst->data, dst->n_data, dst->lo, dst->hi, q);
+      free(dst->data);
+      dst->data = q;
+    }
+
+    obj_cache_write(dst, path, hash, src.len, flags);
+  }
+
+  file_map_close(&src);
+
+  size_t before = dst->lod_off[1] * sizeof(struct vt);
+  size_t after = (size_t)dst->n_data * dst->vt_size + (size_t)dst->n_inds * dst->ind_size;
+  printf("%s: %d -> %d vertices, %d-bit indices, %.2f -> %.2f MB%s in %.1f ms\n",
+         file, dst->lod_off[1], dst->n_data, dst->ind_size * 8,
+         before / 1048576., after / 1048576., cached ? " (cached)" : "", (sys_time() - t0) * 1e3);
+  printf("%s: acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+         file, dst->acmr[0], dst->acmr[1], dst->atvr[0], dst->atvr[1]);
+
+  for (int i = 1; i < dst->n_lods; i++) {
+    printf("%s: lod %d, %d triangles, error %g\n",
+           file, i, (dst->lod_off[i + 1] - dst->lod_off[i]) / 3, dst->lod_err[i]);
+  }
+  prof_end(zone);
+}
+
+/*-- streaming --*/
+
+/**
+ * a bounded-memory import for files that don't fit in ram. a pre-scan
+ * counts the records so the consumer can allocate the whole vertex buffer
+ * up front, then the file is read again in text windows of budget / 4 and
+ * every face is resolved straight into one of two blocks of budget / 8.
+ * full blocks are handed to the GL thread, which uploads them at blk_off
+ * and releases them while the other block fills. the position and normal
+ * pools are the only part that grows with the file; past budget / 2 they
+ * spill to a scratch mapping. there is no welding, reordering or cache,
+ * the result is a flat struct vt triangle list of n_verts
+ */
+struct obj_stream {
+  char const *file;
+  int flags;
+  size_t budget;
+
+  atomic_bool scanned;
+  int64_t n_verts;
+  bool spilled;
+  v3 lo, hi;
+
+  mtx_t mtx;
+  cnd_t cnd;
+  struct vt *blk[2];
+  int64_t blk_cap, blk_off[2], blk_n[2];
+  bool blk_full[2], done;
+};
+
+static void
+obj_stream_init(struct obj_stream *st, char const *file, int flags, size_t budget) {
+  *st = (struct obj_stream){.file = file, .flags = flags, .budget = budget};
+  st->blk_cap = max((int64_t)(budget / 8 / sizeof(struct vt)) / 3 * 3, (int64_t)3 << 12);
+  st->blk[0] = malloc(sizeof(struct vt) * st->blk_cap);
+  st->blk[1] = malloc(sizeof(struct vt) * st->blk_cap);
+  mtx_init(&st->mtx, mtx_plain);
+  cnd_init(&st->cnd);
+}
+
+static void
+obj_stream_free(struct obj_stream *st) {
+  free(st->blk[0]);
+  free(st->blk[1]);
+  mtx_destroy(&st->mtx);
+  cnd_destroy(&st->cnd);
+}
+
+struct obj_reader {
+  FILE *fp;
+  char *buf;
+  size_t cap, len, pos;
+};
+
+/**
+ * the next run of whole lines, at most cap bytes. a trailing partial line
+ * is carried over to the next call
+ */
+static bool
+obj_read_lines(struct obj_reader *r, char const **beg, char const **end) {
+  memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+  r->len -= r->pos;
+  r->pos = 0;
+
+  r->len += fread(r->buf + r->len, 1, r->cap - r->len, r->fp);
+  if (r->len == 0) return false;
+
+  size_t last = r->len;
+  if (r->len == r->cap) {
+    while (last > 0 && r->buf[last - 1] != '\n') last--;
+    if (last == 0) {
+      err("line longer than the %zu byte stream window", r->cap);
+    }
+  }
+
+  *beg = r->buf;
+  *end = r->buf + last;
+  r->pos = last;
+  return true;
+}
+
+/**
+ * hands block *cur to the consumer and waits until the other one is free
+ */
+static void
+obj_stream_submit(struct obj_stream *st, int *cur, int64_t off, int64_t n) {
+  mtx_lock(&st->mtx);
+  st->blk_off[*cur] = off;
+  st->blk_n[*cur] = n;
+  st->blk_full[*cur] = true;
+  cnd_broadcast(&st->cnd);
+
+  *cur ^= 1;
+  while (st->blk_full[*cur]) cnd_wait(&st->cnd, &st->mtx);
+  mtx_unlock(&st->mtx);
+}
+
+/**
+ * the producer, meant to run on its own thread
+ */
+static int
+obj_stream_run(void *arg) {
+  prof_begin(zone, "obj_stream_run");
+  struct obj_stream *st = arg;
+  double t0 = sys_time();
+  bool t = st->flags & obj_vt;
+
+  struct obj_reader r = {.cap = max(st->budget / 4, (size_t)1 << 20)};
+  r.buf = malloc(r.cap);
+  if (!(r.fp = fopen(st->file, "rb"))) {
+    err("failed to open %s", st->file);
+  }
+
+  int64_t np = 0, nn = 0, nf = 0;
+  char const *s, *end;
+  while (obj_read_lines(&r, &s, &end)) {
+    while (s < end) {
+      char c0 = s[0], c1 = end - s > 1 ? s[1] : 0;
+      np += c0 == 'v' && c1 == ' ';
+      nn += c0 == 'v' && c1 == 'n';
+      nf += c0 == 'f' && c1 == ' ';
+      s = obj_eol(s, end) + 1;
+    }
+  }
+
+  st->n_verts = nf * 3;
+  atomic_store(&st->scanned, true);
+
+  struct file_map spill = {0};
+  size_t pool_len = sizeof(v3) * (size_t)max(np + nn, 1);
+  v3 *p;
+  if (pool_len <= st->budget / 2) {
+    p = malloc(pool_len);
+  } else {
+    if (!file_map_scratch(&spill, pool_len)) {
+      err("failed to map %zu bytes of scratch for %s", pool_len, st->file);
+    }
+
+    p = (v3 *)spill.data;
+    st->spilled = true;
+  }
+
+  v3 *n = p + np;
+
+  rewind(r.fp);
+  r.len = r.pos = 0;
+
+  st->lo = (v3){INFINITY, INFINITY, INFINITY};
+  st->hi = v3_neg(st->lo);
+
+  int cur = 0;
+  int64_t off = 0, nv = 0;
+  struct vt *v = st->blk[0];
+  np = nn = 0;
+
+  while (obj_read_lines(&r, &s, &end)) {
+    while (s < end) {
+      char c0 = s[0], c1 = end - s > 1 ? s[1] : 0;
+      char const *q = s;
+
+      if (c0 == 'v' && c1 == ' ') {
+        q = obj_float(s + 2, end, &p[np].x);
+        q = obj_float(q, end, &p[np].y);
+        q = obj_float(q, end, &p[np].z);
+        st->lo = v3_min(st->lo, p[np]);
+        st->hi = v3_max(st->hi, p[np]);
+        np++;
+      } else if (c0 == 'v' && c1 == 'n') {
+        q = obj_float(s + 3, end, &n[nn].x);
+        q = obj_float(q, end, &n[nn].y);
+        q = obj_float(q, end, &n[nn].z);
+        v3_norm(&n[nn]);
+        nn++;
+      } else if (c0 == 'f' && c1 == ' ') {
+        if (nv + 3 > st->blk_cap) {
+          obj_stream_submit(st, &cur, off, nv);
+          off += nv, nv = 0;
+          v = st->blk[cur];
+        }
+
+        q = s + 2;
+        for (int i = 0; i < 3; i++) {
+          long pi, ni, ti;
+          q = obj_int(q, end, &pi);
+          if (q < end && *q == '/') q++;
+          if (t) q = obj_int(q, end, &ti);
+          if (q < end && *q == '/') q++;
+          q = obj_int(q, end, &ni);
+
+          int64_t a = pi < 0 ? np + pi : pi - 1;
+          int64_t b = ni < 0 ? nn + ni : ni - 1;
+          if (a < 0 || a >= np || b < 0 || b >= nn) {
+            err("face index out of range (p %lld/%lld, n %lld/%lld)", (long long)a, (long long)np, (long long)b, (long long)nn);
+          }
+
+          v[nv++] = (struct vt){p[a], n[b]};
+        }
+      }
+
+      s = obj_eol(q, end) + 1;
+    }
+  }
+
+  if (nv) obj_stream_submit(st, &cur, off, nv);
+
+  mtx_lock(&st->mtx);
+  st->done = true;
+  cnd_broadcast(&st->cnd);
+  mtx_unlock(&st->mtx);
+
+  fclose(r.fp);
+  free(r.buf);
+  if (st->spilled) file_map_close(&spill);
+  else free(p);
+
+  printf("%s: streamed %lld vertices, %.2f MB, pools %.2f MB%s in %.1f ms\n",
+         st->file, (long long)st->n_verts, st->n_verts * sizeof(struct vt) / 1048576.,
+         pool_len / 1048576., st->spilled ? " (spilled)" : "", (sys_time() - t0) * 1e3);
+  prof_end(zone);
+  return 0;
+}
+
+/**
+ * the full block with the lowest offset, or NULL. taking them in order
+ * means everything below the last upload is valid to draw
+ */
+static struct vt const *
+obj_stream_peek(struct obj_stream *st, int *slot, int64_t *off, int64_t *n) {
+  mtx_lock(&st->mtx);
+  int i = st->blk_full[0] && (!st->blk_full[1] || st->blk_off[0] < st->blk_off[1]) ? 0
+          : st->blk_full[1] ? 1 : -1;
+  mtx_unlock(&st->mtx);
+
+  if (i < 0) return NULL;
+  *slot = i;
+  *off = st->blk_off[i];
+  *n = st->blk_n[i];
+  return st->blk[i];
+}
+
+static void
+obj_stream_release(struct obj_stream *st, int slot) {
+  mtx_lock(&st->mtx);
+  st->blk_full[slot] = false;
+  cnd_broadcast(&st->cnd);
+  mtx_unlock(&st->mtx);
+}
+
+/**
+ * true once the producer has finished and every block was released
+ */
+static bool
+obj_stream_done(struct obj_stream *st) {
+  mtx_lock(&st->mtx);
+  bool done = st->done && !st->blk_full[0] && !st->blk_full[1];
+  mtx_unlock(&st->mtx);
+  return done;
+}
+
+/*-- clusters --*/
+
+/**
+ * builds clusters over m's first level from its positions as the GPU
+ * will see them, i.e. dequantized for obj_quant
+ */
+static void
+obj_clusters(struct geom_clusters *dst, struct obj_mesh const *m) {
+  v3 *p = malloc(sizeof(v3) * max(m->n_data, 1));
+  if (m->vt_size == sizeof(struct vtq)) {
+    struct vtq const *q = m->data;
+    v3 ext = v3_div(v3_sub(m->hi, m->lo), 65535);
+    for (int i = 0; i < m->n_data; i++) {
+      p[i] = v3_add(m->lo, v3_mul_v((v3){q[i].p[0], q[i].p[1], q[i].p[2]}, ext));
+    }
+  } else {
+    struct vt const *v = m->data;
+    for (int i = 0; i < m->n_data; i++) {
+      p[i] = v[i].p;
+    }
+  }
+
+  geom_clusters_build(dst, m->inds, m->ind_size, m->lod_off[1], p, m->n_data);
+  free(p);
+}
+
+#if PROF
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+
+/**
+ * Tracy hooks. builds with the tracy submodule checked out get the real
+ * client, started on demand so nothing is collected until a profiler
+ * attaches; without it, or with TRACY_ENABLE undefined, every hook here
+ * compiles to nothing
+ */
+
+#include "typedefs.h"
+
+#if defined(TRACY_ENABLE) && __has_include(<tracy/TracyC.h>)
+#include <tracy/TracyC.h>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#define PROF 1
+
+/**
+ * name has to be a string literal: it ends up in a static source location
+ */
+#define prof_begin(ctx, name) TracyCZoneN(ctx, name, 1)
+#define prof_end(ctx) TracyCZoneEnd(ctx)
+
+/**
+ * renames an open zone at run time, for zones that share a call site
+ */
+#define prof_name(ctx, str) TracyCZoneName(ctx, str, strlen(str))
+
+#define prof_frame() TracyCFrameMark
+#define prof_plot(name, v) TracyCPlot(name, (double)(v))
+
+/**
+ * usable size of a live block, which is at least what was asked for
+ */
+static size_t
+prof_size(void *p) {
+#if defined(_WIN32)
+  return _msize(p);
+#elif defined(__APPLE__)
+  return malloc_size(p);
+#else
+  return malloc_usable_size(p);
+#endif
+}
+
+static void *
+prof_malloc(size_t n) {
+  void *p = malloc(n);
+  if (p) TracyCAlloc(p, n);
+  return p;
+}
+
+static void *
+prof_calloc(size_t n, size_t size) {
+  void *p = calloc(n, size);
+  if (p) TracyCAlloc(p, n * size);
+  return p;
+}
+
+/**
+ * p's free is reported before realloc can hand its address to another
+ * thread. a failed realloc leaves p live, so it is reported again at the
+ * size the allocator says it has
+ */
+static void *
+prof_realloc(void *p, size_t n) {
+  size_t old_n = p ? prof_size(p) : 0;
+  if (p) TracyCFree(p);
+
+  void *q = realloc(p, n);
+  if (q) TracyCAlloc(q, n);
+  else if (p) TracyCAlloc(p, old_n);
+  return q;
+}
+
+static void
+prof_free(void *p) {
+  if (p) TracyCFree(p);
+  free(p);
+}
+
+#else
+
+#define PROF 0
+
+#define prof_begin(ctx, name) ((void)0)
+#define prof_end(ctx) ((void)0)
+#define prof_name(ctx, str) ((void)0)
+#define prof_frame() ((void)0)
+#define prof_plot(name, v) ((void)0)
+
+#define prof_malloc malloc
+#define prof_calloc calloc
+#define prof_realloc realloc
+#define prof_free free
+
+#endif
@@ -0,0 +1,54 @@
+// what every stage gets, spliced in by main after the defines: the
+// per-frame block, row_major so u_vp reads the same as camera.vp is laid
+// out in C, the per-draw records vertex shaders index with
+// gl_BaseInstance, and the instance transforms those records point into
+
+layout (std140, row_major, binding = 0) uniform frame {
+  mat4 u_vp;
+  vec3 u_eye;
+  float u_time;
+  vec2 u_size;
+};
+
+struct draw {
+  vec3 qmin;
+  uint ids;
+  vec3 qext;
+  int base;
+};
+
+// rows of a 3x4 affine transform, and a tint
+struct instance {
+  vec4 m[3];
+  vec4 color;
+};
+
+layout (std430, binding = 1) readonly buffer draws {
+  draw u_draws[];
+};
+
+layout (std430, binding = 2) readonly buffer instances {
+  instance u_insts[];
+};
+
+layout (std430, binding = 3) readonly buffer instance_ids {
+  uint u_inst_ids[];
+};
+
+vec3
+inst_point(instance x, vec3 p) {
+  vec4 h = vec4(p, 1.);
+  return vec3(dot(x.m[0], h), dot(x.m[1], h), dot(x.m[2], h));
+}
+
+// n through the inverse-transpose of x's linear part, so normals stay
+// perpendicular under non-uniform scale. rows of the cofactor matrix stand
+// in for it: off only by det, whose sign is kept so mirrored instances
+// don't flip, and whose size normalize() drops
+vec3
+inst_normal(instance x, vec3 n) {
+  vec3 r0 = x.m[0].xyz, r1 = x.m[1].xyz, r2 = x.m[2].xyz;
+  vec3 c0 = cross(r1, r2);
+  vec3 c = vec3(dot(c0, n), dot(cross(r2, r0), n), dot(cross(r0, r1), n));
+  return dot(r0, c0) < 0. ? -c : c;
+}
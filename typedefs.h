@@ -2,6 +2,47 @@
 
 #include "tgmath.h"
 #include "stdint.h"
+#include "limits.h"
+#include "stdbool.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#endif
+
+/* Windows.h may have come in first with its own, which take a and b twice */
+#undef min
+#undef max
+
+#define minmax_fns(T, s) \
+  inline static T min_##s(T a, T b) { return a < b ? a : b; } \
+  inline static T max_##s(T a, T b) { return a > b ? a : b; }
+
+minmax_fns(int, i)
+minmax_fns(unsigned, u)
+minmax_fns(long, l)
+minmax_fns(unsigned long, ul)
+minmax_fns(long long, ll)
+minmax_fns(unsigned long long, ull)
+minmax_fns(float, f)
+minmax_fns(double, d)
+
+#undef minmax_fns
+
+/**
+ * a and b are each evaluated once, as the type they'd be compared in.
+ * pointers don't compile: compare those by hand
+ */
+#define minmax_of(fn, a, b) _Generic(1 ? (a) : (b), \
+  int: fn##_i, unsigned: fn##_u, long: fn##_l, unsigned long: fn##_ul, \
+  long long: fn##_ll, unsigned long long: fn##_ull, float: fn##_f, double: fn##_d)((a), (b))
+
+#define min(a, b) minmax_of(min, a, b)
+#define max(a, b) minmax_of(max, a, b)
 
 #define err(fmt, ...) do { \
   fprintf(stderr, "%s:%s:%d :: ", __FILE__, __func__, __LINE__); \
@@ -18,6 +59,24 @@
 
 #define splat_arr(a) a.data, a.count, a.cap
 
+/**
+ * seconds on a monotonic clock, for timing. only differences mean anything
+ */
+static double
+sys_time(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
 static char *read_txt_file_len(char const *path, size_t *len)
 {
   FILE *file = fopen(path, "r");
@@ -52,13 +111,13 @@ static uint32_t hash_murmur3(const void *data, size_t nbytes)
   const uint32_t c1 = 0xcc9e2d51;
   const uint32_t c2 = 0x1b873593;
 
-  const int nblocks = nbytes / 4;
+  const size_t nblocks = nbytes / 4;
   const uint32_t *blocks = (const uint32_t *)(data);
   const uint8_t *tail = (const uint8_t *)(data + (nblocks * 4));
 
   uint32_t h = 0;
 
-  int i;
+  size_t i;
   uint32_t k;
   for (i = 0; i < nblocks; i++)
   {
@@ -515,7 +574,12 @@ static void m4_print(m4 m)
   printf("%f %f %f %f\n", m._30, m._31, m._32, m._33);
 }
 
-static const m4 m4_ident = (m4){.r = {v4_ux, v4_uy, v4_uz, v4_uw}};
+static const m4 m4_ident = (m4){.e = {
+  1, 0, 0, 0,
+  0, 1, 0, 0,
+  0, 0, 1, 0,
+  0, 0, 0, 1
+}};
 
 [[gnu::always_inline]]
 